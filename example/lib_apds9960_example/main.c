@@ -19,6 +19,14 @@
 #include "epoll_timerfd_utilities.h"
 
 #include "lib_apds9960.h"
+#include "apds9960_irq.h"
+#include "apds9960_lux.h"
+
+// Uncomment line below to time lux/CCT conversion on target at startup
+//#define LUX_BENCHMARK
+
+#define LUX_BENCHMARK_CONVERSIONS   100000
+#define LUX_BENCHMARK_CPU_MHZ       500     // MT3620 Cortex-A7 core clock
 
 /*******************************************************************************
 * Forward declarations of private functions
@@ -66,7 +74,49 @@ static void
 apds9960_interrupt_handler(void);
 
 static void
-apds9960_int_timer_event_handler(EventData *event_data);
+apds9960_int_event_handler(EventData *event_data);
+
+/**
+ * @brief Read APDS9960 INT pin level for interrupt poll source.
+ *
+ * @param p_ctx Unused.
+ * @param p_is_asserted Set to true when INT pin is low.
+ *
+ * @return true on success.
+ */
+static bool
+apds9960_int_read_level(void *p_ctx, bool *p_is_asserted);
+
+static void
+apds9960_gesture_timer_event_handler(EventData *event_data);
+
+static void
+apds9960_gesture_step(void);
+
+/**
+ * @brief Print every gesture of the ended gesture sequence.
+ *
+ * Interrupt service gesture callback.
+ *
+ * @param p_ctx Unused.
+ * @param gesture Last gesture of the sequence.
+ */
+static void
+apds9960_gesture_callback(void *p_ctx, int gesture);
+
+static void
+print_gesture(int gesture);
+
+#ifdef LUX_BENCHMARK
+/**
+ * @brief Time fixed-point lux/CCT conversions and log cost per conversion.
+ *
+ * Cortex-A7 cycle counter is not accessible to applications, cycles are
+ * derived from elapsed time and core clock.
+ */
+static void
+lux_benchmark(void);
+#endif
 
 /*******************************************************************************
 * Global variables
@@ -78,11 +128,19 @@ static int i2c_fd = -1;
 static int epoll_fd = -1;
 static apds9960_t *p_apds;
 
-static int apds9960_int_poll_timer_fd = -1;
 static int apds9960_int_gpio_fd = -1;
-static GPIO_Value_Type apds9960_int_state = GPIO_Value_High;
+static apds9960_irq_t *p_apds9960_irq;
 static EventData apds9960_int_event_data = {
-    .eventHandler = &apds9960_int_timer_event_handler
+    .eventHandler = &apds9960_int_event_handler
+};
+
+static int apds9960_gesture_timer_fd = -1;
+static EventData apds9960_gesture_event_data = {
+    .eventHandler = &apds9960_gesture_timer_event_handler
+};
+
+static const apds9960_callbacks_t apds9960_callbacks = {
+    .gesture = &apds9960_gesture_callback
 };
 
 
@@ -112,6 +170,10 @@ main(int argc, char *argv[])
         }
     }
 
+#ifdef LUX_BENCHMARK
+    lux_benchmark();
+#endif
+
     // Main program
     if (!gb_is_termination_requested)
     {
@@ -130,10 +192,7 @@ main(int argc, char *argv[])
 
         //uint8_t counter = 0;
         //struct timespec sleep_time;
-        //uint16_t clear_value;
-        //uint16_t red_value;
-        //uint16_t green_value;
-        //uint16_t blue_value;
+        //apds9960_rgbc_t rgbc;
 
         //uint8_t prox_value;
 
@@ -144,11 +203,8 @@ main(int argc, char *argv[])
         while (!gb_is_termination_requested)
         {
             /*
-            apds9960_als_read_clear(p_apds, &clear_value);
-            apds9960_als_read_red(p_apds, &red_value);
-            apds9960_als_read_green(p_apds, &green_value);
-            apds9960_als_read_blue(p_apds, &blue_value);
-            Log_Debug("ALS: clear 0x%04X, red 0x%04X, green 0x%04X, blue 0x%04X \n", clear_value, red_value, green_value, blue_value);
+            apds9960_als_read_rgbc(p_apds, &rgbc);
+            Log_Debug("ALS: clear 0x%04X, red 0x%04X, green 0x%04X, blue 0x%04X \n", rgbc.clear, rgbc.red, rgbc.green, rgbc.blue);
 
             apds9960_proximity_read(p_apds, &prox_value);
             Log_Debug("Proximity: 0x%02X\n", prox_value);
@@ -267,6 +323,10 @@ init_peripherals(I2C_InterfaceId isu_id)
             Log_Debug("ERROR> Could not initialize APDS9960.\n");
             result = -1;
         }
+        else
+        {
+            apds9960_set_callbacks(p_apds, &apds9960_callbacks, NULL);
+        }
 
     }
 
@@ -282,15 +342,34 @@ init_peripherals(I2C_InterfaceId isu_id)
         }
     }
 
-    // Create timer for apds9960 interrupt signal check
+    // Create apds9960 interrupt source. Applibs GPIO has no edge events,
+    // INT pin level is polled.
+    if (result != -1)
+    {
+        p_apds9960_irq = apds9960_irq_open_poll(apds9960_int_read_level, NULL,
+            APDS9960_IRQ_POLL_PERIOD_MS);
+        if (!p_apds9960_irq)
+        {
+            Log_Debug("ERROR: Could not create interrupt source.\n");
+            result = -1;
+        }
+        else
+        {
+            result = RegisterEventHandlerToEpoll(epoll_fd,
+                apds9960_irq_get_fd(p_apds9960_irq), &apds9960_int_event_data,
+                EPOLLIN);
+        }
+    }
+
+    // Create disarmed one-shot timer for gesture read steps
     if (result != -1)
     {
-        struct timespec apds9960_int_check_period = { 0, 100000000 };
-        apds9960_int_poll_timer_fd = CreateTimerFdAndAddToEpoll(epoll_fd,
-            &apds9960_int_check_period, &apds9960_int_event_data, EPOLLIN);
-        if (apds9960_int_poll_timer_fd < 0)
+        struct timespec disarmed = { 0, 0 };
+        apds9960_gesture_timer_fd = CreateTimerFdAndAddToEpoll(epoll_fd,
+            &disarmed, &apds9960_gesture_event_data, EPOLLIN);
+        if (apds9960_gesture_timer_fd < 0)
         {
-            Log_Debug("ERROR: Could not create interrupt poll timer: %s (%d).\n",
+            Log_Debug("ERROR: Could not create gesture timer: %s (%d).\n",
                 strerror(errno), errno);
             result = -1;
         }
@@ -312,9 +391,13 @@ close_peripherals_and_handlers(void)
     // Close I2C
     CloseFdAndPrintError(i2c_fd, "I2C");
 
-    // Close APDS9960 interrupt GPIO fd
+    // Close APDS9960 interrupt source and GPIO fd
+    apds9960_irq_close(p_apds9960_irq);
     CloseFdAndPrintError(apds9960_int_gpio_fd, "APDS9960 INT GPIO");
 
+    // Close timers
+    CloseFdAndPrintError(apds9960_gesture_timer_fd, "APDS9960 gesture timer");
+
     // Close Epoll fd
     CloseFdAndPrintError(epoll_fd, "Epoll");
 
@@ -323,76 +406,184 @@ close_peripherals_and_handlers(void)
 static void
 apds9960_interrupt_handler(void)
 {
-    bool b_gesture_valid;
-    apds9960_gesture_is_valid(p_apds, &b_gesture_valid);
+    // Service interrupt sources, gesture steps are driven by gesture timer
+    apds9960_gesture_step();
+}
+
+static void
+apds9960_gesture_step(void)
+{
+    struct timespec now;
+    struct timespec next_deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    if (b_gesture_valid)
+    if (!apds9960_service_interrupt(p_apds, &next_deadline))
     {
-        int gesture = apds9960_gesture_read(p_apds);
+        Log_Debug("ERROR: Could not service interrupt.\n");
+    }
 
-        Log_Debug("Gesture %d ", gesture);
+    // Schedule next step while gesture is in progress
+    if ((next_deadline.tv_sec != 0) || (next_deadline.tv_nsec != 0))
+    {
+        struct timespec delay;
+
+        delay.tv_sec = next_deadline.tv_sec - now.tv_sec;
+        delay.tv_nsec = next_deadline.tv_nsec - now.tv_nsec;
+        if (delay.tv_nsec < 0)
+        {
+            delay.tv_sec--;
+            delay.tv_nsec += 1000000000;
+        }
+
+        // Zero expiry would disarm the timer
+        if ((delay.tv_sec < 0) || ((delay.tv_sec == 0) && (delay.tv_nsec == 0)))
+        {
+            delay.tv_sec = 0;
+            delay.tv_nsec = 1;
+        }
 
-        switch (gesture)
+        if (SetTimerFdToSingleExpiry(apds9960_gesture_timer_fd, &delay) != 0)
         {
-        case GESTURE_DIR_UP:
-            Log_Debug("Up\n");
-            break;
-        case GESTURE_DIR_DOWN:
-            Log_Debug("Down\n");
-            break;
-        case GESTURE_DIR_LEFT:
-            Log_Debug("Left\n");
-            break;
-        case GESTURE_DIR_RIGHT:
-            Log_Debug("Right\n");
-            break;
-        case GESTURE_DIR_FAR:
-            Log_Debug("Far\n");
-            break;
-        case GESTURE_DIR_NEAR:
-            Log_Debug("Near\n");
-            break;
-
-        default:
-            Log_Debug("Unknown\n");
-            break;
+            gb_is_termination_requested = true;
         }
+    }
+}
+
+static void
+apds9960_gesture_callback(void *p_ctx, int gesture)
+{
+    // Print every gesture of the sequence
+    apds9960_gesture_event_t events[APDS9960_GESTURE_EVENTS_MAX];
+    size_t count = apds9960_gesture_events_read(p_apds, events,
+        APDS9960_GESTURE_EVENTS_MAX);
 
-        Log_Debug("\n");
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        Log_Debug("[%ld.%03ld] %u datasets, %u ms: ",
+            (long)events[idx].timestamp.tv_sec,
+            events[idx].timestamp.tv_nsec / 1000000,
+            events[idx].dset_count, events[idx].duration_ms);
+        print_gesture(events[idx].gesture);
     }
+}
+
+static void
+print_gesture(int gesture)
+{
+    Log_Debug("Gesture %d ", gesture);
 
+    switch (gesture)
+    {
+    case GESTURE_DIR_UP:
+        Log_Debug("Up\n");
+        break;
+    case GESTURE_DIR_DOWN:
+        Log_Debug("Down\n");
+        break;
+    case GESTURE_DIR_LEFT:
+        Log_Debug("Left\n");
+        break;
+    case GESTURE_DIR_RIGHT:
+        Log_Debug("Right\n");
+        break;
+    case GESTURE_DIR_FAR:
+        Log_Debug("Far\n");
+        break;
+    case GESTURE_DIR_NEAR:
+        Log_Debug("Near\n");
+        break;
+
+    default:
+        Log_Debug("Unknown\n");
+        break;
+    }
 
+    Log_Debug("\n");
 }
 
 static void
-apds9960_int_timer_event_handler(EventData *event_data)
+apds9960_gesture_timer_event_handler(EventData *event_data)
 {
     // Consume timer event
-    if (ConsumeTimerFdEvent(apds9960_int_poll_timer_fd) != 0) {
+    if (ConsumeTimerFdEvent(apds9960_gesture_timer_fd) != 0) {
         gb_is_termination_requested = true;
         return;
     }
 
-    // Check for interrupt signal state change
-    GPIO_Value_Type new_apds9960_int_state;
+    apds9960_gesture_step();
+}
+
+static void
+apds9960_int_event_handler(EventData *event_data)
+{
+    int result = apds9960_irq_handle(p_apds9960_irq);
+
+    if (result == -1)
+    {
+        gb_is_termination_requested = true;
+    }
+    else if (result == 1)
+    {
+        // apds9960 /INT pin is asserted. New measurement is available.
+        apds9960_interrupt_handler();
+    }
+}
+
+static bool
+apds9960_int_read_level(void *p_ctx, bool *p_is_asserted)
+{
+    GPIO_Value_Type int_state;
 
-    int result = GPIO_GetValue(apds9960_int_gpio_fd, &new_apds9960_int_state);
+    int result = GPIO_GetValue(apds9960_int_gpio_fd, &int_state);
     if (result != 0) {
         Log_Debug("ERROR: Could not read apds9960 interrupt GPIO: %s (%d).\n",
             strerror(errno), errno);
-        gb_is_termination_requested = true;
-        return;
     }
 
-    if (new_apds9960_int_state != apds9960_int_state)
+    *p_is_asserted = (result == 0) && (int_state == GPIO_Value_Low);
+
+    return (result == 0);
+}
+
+#ifdef LUX_BENCHMARK
+static void
+lux_benchmark(void)
+{
+    apds9960_lux_t lux;
+    apds9960_light_t light;
+    apds9960_rgbc_t rgbc;
+    struct timespec start;
+    struct timespec end;
+    volatile uint32_t sum = 0;
+
+    apds9960_lux_init(&lux, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t idx = 0; idx < LUX_BENCHMARK_CONVERSIONS; idx++)
     {
-        if (new_apds9960_int_state == GPIO_Value_Low)
-        {
-            // apds9960 /INT pin is asserted. New measurement is available.
-            apds9960_interrupt_handler();
-        }
-        apds9960_int_state = new_apds9960_int_state;
+        // Counts vary with loop, range changes every 64 conversions
+        rgbc.clear = (uint16_t)(idx & 0x3FFF);
+        rgbc.red = (uint16_t)(rgbc.clear / 3 + (idx & 0xFF));
+        rgbc.green = (uint16_t)(rgbc.clear / 3);
+        rgbc.blue = (uint16_t)(rgbc.clear / 4);
+
+        apds9960_lux_compute(&lux, &rgbc, (uint8_t)(1 << (2 * ((idx >> 6) & 3))),
+            APDS9960_ALS_CYCLE_US * 16, &light);
+        sum += light.lux_milli + light.cct;
     }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint64_t elapsed_ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 +
+        (uint64_t)(end.tv_nsec - start.tv_nsec);
+    uint32_t ns = (uint32_t)(elapsed_ns / LUX_BENCHMARK_CONVERSIONS);
+
+    Log_Debug("Lux: %u conversions, %u ns/conversion, ~%u cycles/conversion "
+        "at %u MHz (sum %u)\n", LUX_BENCHMARK_CONVERSIONS, ns,
+        ns * LUX_BENCHMARK_CPU_MHZ / 1000, LUX_BENCHMARK_CPU_MHZ, sum);
 }
+#endif
 
 /* [] END OF FILE */
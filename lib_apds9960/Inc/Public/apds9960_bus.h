@@ -0,0 +1,89 @@
+/***************************************************************************//**
+* @file    apds9960_bus.h
+* @version 1.0.0
+*
+* @brief Several sensors at the same address behind TCA9548A I2C muxes.
+*
+* The bus owns the I2C descriptor and opens every sensor with a transport
+* which selects the sensor's mux channel before its transactions. Channel
+* selection of every mux is cached, the mux is written only when the next
+* transaction targets another channel. Only one channel of all muxes is
+* selected at a time, sensors share the address.
+*
+* Work for several sensors is queued with apds9960_bus_request() and run
+* by apds9960_bus_run() grouped by channel, each channel is then selected
+* once per run.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_BUS_H_
+#define _APDS9960_BUS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+
+#define APDS9960_BUS_MUX_MAX        8       // TCA9548A addresses 0x70 - 0x77
+#define APDS9960_BUS_CHANNELS       8       // Channels of one mux
+#define APDS9960_BUS_SENSORS_MAX    (APDS9960_BUS_MUX_MAX * APDS9960_BUS_CHANNELS)
+#define APDS9960_BUS_NO_MUX         -1      // Sensor on the upstream bus
+
+typedef struct apds9960_bus apds9960_bus_t;
+
+// Operation run for one sensor, returns false on error
+typedef bool (*apds9960_bus_op_t)(apds9960_t *p_apds, void *p_ctx);
+
+// Bus statistics
+typedef struct
+{
+    uint32_t transactions;      // Sensor transactions
+    uint32_t mux_writes;        // Channel select transactions
+} apds9960_bus_stats_t;
+
+// Take ownership of i2c_fd, transactions go through p_transport (NULL for
+// default transport)
+apds9960_bus_t
+*apds9960_bus_open(const apds9960_transport_t *p_transport,
+    void *p_transport_ctx, int i2c_fd);
+
+// Close all sensors, deselect muxes and close descriptor
+void
+apds9960_bus_close(apds9960_bus_t *p_bus);
+
+// Register mux at mux_addr, all its channels are deselected. Returns mux
+// index or -1 on error.
+int
+apds9960_bus_add_mux(apds9960_bus_t *p_bus, I2C_DeviceAddress mux_addr);
+
+// Open sensor on channel of mux, mux_index APDS9960_BUS_NO_MUX for one on
+// the upstream bus. The descriptor is closed by apds9960_bus_close().
+apds9960_t
+*apds9960_bus_open_sensor(apds9960_bus_t *p_bus, int mux_index,
+    uint8_t channel);
+
+// Queue sensor for next apds9960_bus_run(), NULL queues all sensors
+void
+apds9960_bus_request(apds9960_bus_t *p_bus, apds9960_t *p_apds);
+
+// Run op for queued sensors grouped by channel, selected channel first.
+// Queue is emptied. Returns false when some op failed, all are run.
+bool
+apds9960_bus_run(apds9960_bus_t *p_bus, apds9960_bus_op_t op, void *p_ctx);
+
+void
+apds9960_bus_get_stats(const apds9960_bus_t *p_bus,
+    apds9960_bus_stats_t *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_BUS_H_
+
+/* [] END OF FILE */
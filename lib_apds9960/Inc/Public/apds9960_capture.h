@@ -0,0 +1,119 @@
+/***************************************************************************//**
+* @file    apds9960_capture.h
+* @version 1.0.0
+*
+* @brief Gesture FIFO capture recording and replay.
+*
+* Capture file layout, all values little-endian:
+*   Header:  "AGCP", version byte, 3 reserved bytes
+*   Records: type, payload length, arg0, arg1, uint32 time since previous
+*            record in microseconds, followed by payload
+*
+*   BATCH   arg0 GFLVL, arg1 GSTATUS, payload GFLVL U/D/L/R datasets
+*   CONFIG  payload apds9960_capture_config_t register values
+*   LABEL   arg0 expected gesture GESTURE_DIR_* of following datasets
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_CAPTURE_H_
+#define _APDS9960_CAPTURE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+
+#define APDS9960_CAPTURE_VERSION        1
+#define APDS9960_CAPTURE_HEADER_SIZE    8
+#define APDS9960_CAPTURE_RECORD_SIZE    8       // Record header size
+#define APDS9960_CAPTURE_BUFFER_SIZE    1024    // Writer buffer size
+
+enum {
+    CAPTURE_REC_BATCH = 1,
+    CAPTURE_REC_CONFIG,
+    CAPTURE_REC_LABEL
+};
+
+// Gesture engine settings active during capture
+typedef struct
+{
+    uint8_t gpenth;
+    uint8_t gexth;
+    uint8_t gconf1;
+    uint8_t gconf2;
+    uint8_t gpulse;
+    uint8_t gconf3;
+    uint8_t gconf4;
+    uint8_t config2;
+} apds9960_capture_config_t;
+
+// Capture writer, records are buffered and written to fd when buffer fills
+typedef struct
+{
+    int fd;
+    uint8_t buffer[APDS9960_CAPTURE_BUFFER_SIZE];
+    size_t buffer_len;
+    struct timespec last_record;    // Time of previous timed record
+    bool b_is_valid_recorded;       // GVALID of previous batch record
+    bool b_is_error;                // Write failed, recording stopped
+} apds9960_capture_t;
+
+// Gesture decoded during replay
+typedef struct
+{
+    uint64_t time_us;       // Capture time of decoding batch
+    int gesture;            // Decoded gesture GESTURE_DIR_*
+    int label;              // Active label, GESTURE_DIR_NONE if unlabeled
+    uint32_t dset_count;    // Datasets of the gesture
+} apds9960_replay_gesture_t;
+
+typedef void (*apds9960_replay_cb_t)(void *p_ctx,
+    const apds9960_replay_gesture_t *p_gesture);
+
+// Start capture to an open file descriptor, writes capture header
+apds9960_capture_t
+*apds9960_capture_open(int fd);
+
+// Flush buffered records and free writer, fd is left open
+bool
+apds9960_capture_close(apds9960_capture_t *p_cap);
+
+bool
+apds9960_capture_flush(apds9960_capture_t *p_cap);
+
+// Record current gesture engine settings of device
+bool
+apds9960_capture_config(apds9960_capture_t *p_cap, const apds9960_t *p_apds);
+
+// Record expected gesture of datasets that follow
+bool
+apds9960_capture_label(apds9960_capture_t *p_cap, int gesture);
+
+// Gesture hook recording FIFO batches, p_ctx is apds9960_capture_t.
+// Install with apds9960_gesture_set_hook().
+void
+apds9960_capture_hook(void *p_ctx, const struct timespec *p_now,
+    apds9960_gstatus_t gstatus, uint8_t dataset_count,
+    const uint8_t *p_datasets);
+
+// Feed capture held in memory through decoder p_dec, initialized by
+// apds9960_gesture_decoder_init(), calling p_callback for every decoded
+// gesture. p_config (may be NULL) receives last recorded
+// settings. Returns number of decoded gestures or -1 on malformed capture.
+int
+apds9960_capture_replay(const uint8_t *p_data, size_t data_len,
+    apds9960_gesture_decoder_t *p_dec, apds9960_replay_cb_t p_callback,
+    void *p_ctx, apds9960_capture_config_t *p_config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_CAPTURE_H_
+
+/* [] END OF FILE */
@@ -0,0 +1,101 @@
+/***************************************************************************//**
+* @file    apds9960_irq.h
+* @version 1.0.0
+*
+* @brief Sensor interrupt (INT pin) sources for event loops.
+*
+* Every interrupt source provides a file descriptor which becomes readable
+* (EPOLLIN) when the active-low INT pin has been asserted. Add it to epoll
+* and call apds9960_irq_handle() when it is readable.
+*
+*   gpiod   Linux GPIO character device edge events, no wakeups while idle
+*   poll    Periodic pin level sampling through a timerfd, fallback for
+*           platforms without GPIO edge events (e.g. Azure Sphere applibs)
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_IRQ_H_
+#define _APDS9960_IRQ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+
+#define APDS9960_IRQ_POLL_PERIOD_MS     100     // Default poll period
+
+typedef struct apds9960_irq apds9960_irq_t;
+
+// Read INT pin level of poll source, *p_is_asserted true when pin is low.
+// Returns false on error.
+typedef bool (*apds9960_irq_level_t)(void *p_ctx, bool *p_is_asserted);
+
+// Interrupt source operations
+typedef struct
+{
+    const char *name;
+
+    // Consume pending fd notifications. Returns 1 when INT was asserted
+    // since last call, 0 when not and -1 on error.
+    int (*handle)(apds9960_irq_t *p_irq);
+
+    // Read current INT pin level
+    bool (*is_asserted)(apds9960_irq_t *p_irq, bool *p_is_asserted);
+
+    void (*close)(apds9960_irq_t *p_irq);
+} apds9960_irq_ops_t;
+
+struct apds9960_irq
+{
+    const apds9960_irq_ops_t *p_ops;
+    int fd;                             // Descriptor to wait on for EPOLLIN
+    apds9960_irq_level_t p_read_level;  // Pin reader of poll source
+    void *p_level_ctx;                  // Pin reader context
+    bool b_is_asserted;                 // Last pin level seen by poll source
+    uint32_t wakeups;                   // Calls of apds9960_irq_handle()
+    uint32_t interrupts;                // INT assertions delivered
+};
+
+// Polling fallback, samples pin every period_ms (0 for default) and reports
+// high to low transitions.
+apds9960_irq_t
+*apds9960_irq_open_poll(apds9960_irq_level_t p_read_level, void *p_ctx,
+    uint32_t period_ms);
+
+#ifdef APDS9960_LINUX_HOST
+// Request line_offset of GPIO chip (e.g. "/dev/gpiochip0") as input with
+// falling edge events.
+apds9960_irq_t
+*apds9960_irq_open_gpiod(const char *p_chip_path, unsigned int line_offset);
+#endif
+
+void
+apds9960_irq_close(apds9960_irq_t *p_irq);
+
+// Descriptor to add to epoll with EPOLLIN
+int
+apds9960_irq_get_fd(const apds9960_irq_t *p_irq);
+
+// Call when descriptor is readable. Returns 1 when the sensor needs service,
+// 0 for spurious wakeups and -1 on error.
+int
+apds9960_irq_handle(apds9960_irq_t *p_irq);
+
+// INT stays low until the sensor is serviced, edge sources do not report
+// an interrupt raised again while servicing. Check after service and repeat
+// it while the pin is asserted.
+bool
+apds9960_irq_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_IRQ_H_
+
+/* [] END OF FILE */
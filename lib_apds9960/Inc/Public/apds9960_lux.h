@@ -0,0 +1,88 @@
+/***************************************************************************//**
+* @file    apds9960_lux.h
+* @version 1.0.0
+*
+* @brief Fixed-point illuminance and colour temperature from ALS samples.
+*
+* Integer implementation of the usual RGBC lux equations:
+*   IR  = (R + G + B - C) / 2
+*   R'  = R - IR, G' = G - IR, B' = B - IR
+*   CPL = (ATIME_ms * AGAIN) / (GA * DF)
+*   lux = (R_coef * R' + G_coef * G' + B_coef * B') / CPL
+*   CCT = CT_coef * B' / R' + CT_offset
+*
+* Range dependent factor 1 / CPL is cached in Q24, a conversion is then a
+* few integer operations, one 64-bit multiply and one 32-bit division.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_LUX_H_
+#define _APDS9960_LUX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+
+// Per-device calibration, coefficients in 1/1000 units
+typedef struct
+{
+    int32_t ga_milli;       // Glass attenuation, 1000 for open air
+    int32_t df;             // Device factor
+    int32_t r_coef_milli;   // Red channel weight
+    int32_t g_coef_milli;   // Green channel weight
+    int32_t b_coef_milli;   // Blue channel weight
+    int32_t ct_coef;        // CCT slope in kelvin
+    int32_t ct_offset;      // CCT offset in kelvin
+} apds9960_lux_cal_t;
+
+// Conversion engine, keeps factor of last ALS range
+typedef struct
+{
+    apds9960_lux_cal_t cal;
+    uint8_t als_gain;       // Range of cached factor
+    uint32_t als_time_us;
+    uint64_t cpl_inv_q24;   // 1 / CPL in milli-lux per count, Q24
+    uint16_t full_scale;    // Saturation level of clear channel
+} apds9960_lux_t;
+
+typedef struct
+{
+    uint32_t lux_milli;     // Illuminance in 1/1000 lux
+    uint16_t cct;           // Correlated colour temperature in kelvin, 0 if
+                            // not determined
+    uint16_t ir;            // Estimated IR component in counts
+} apds9960_light_t;
+
+// Fill p_cal with open-air values for APDS-9960
+void
+apds9960_lux_cal_default(apds9960_lux_cal_t *p_cal);
+
+// NULL p_cal sets defaults
+void
+apds9960_lux_init(apds9960_lux_t *p_lux, const apds9960_lux_cal_t *p_cal);
+
+// Convert colour counts taken with als_gain (1 to 64) and als_time_us
+// integration. Returns false when clear channel is saturated, results are
+// filled in anyway.
+bool
+apds9960_lux_compute(apds9960_lux_t *p_lux, const apds9960_rgbc_t *p_rgbc,
+    uint8_t als_gain, uint32_t als_time_us, apds9960_light_t *p_light);
+
+// Convert sample read by apds9960_read_all(), range is taken from sample
+bool
+apds9960_lux_from_sample(apds9960_lux_t *p_lux,
+    const apds9960_sample_t *p_sample, apds9960_light_t *p_light);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_LUX_H_
+
+/* [] END OF FILE */
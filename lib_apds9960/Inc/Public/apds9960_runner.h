@@ -0,0 +1,87 @@
+/***************************************************************************//**
+* @file    apds9960_runner.h
+* @version 1.0.0
+*
+* @brief Acquisition thread owning the sensor (Linux host builds).
+*
+* The runner thread waits on the interrupt source and service deadlines,
+* calls apds9960_service_interrupt() and pushes timestamped results into a
+* single-producer/single-consumer ring. The application drains the ring
+* when the runner descriptor is readable (EPOLLIN), acquisition timing then
+* does not depend on the application thread load.
+*
+* While the runner is started the sensor descriptor and interrupt source
+* belong to its thread, configure the sensor before start or after stop.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_RUNNER_H_
+#define _APDS9960_RUNNER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+#include "apds9960_irq.h"
+
+#ifdef APDS9960_LINUX_HOST
+
+#define APDS9960_RUNNER_CAPACITY    64      // Default ring capacity in items
+
+enum {
+    RUNNER_ITEM_ALS,            // sample with valid colour data
+    RUNNER_ITEM_PROXIMITY,      // sample.proximity
+    RUNNER_ITEM_PRESENCE,       // event is PRESENCE_EVENT_*
+    RUNNER_ITEM_GESTURE         // event is GESTURE_DIR_*
+};
+
+// Queued result, sample.timestamp is the acquisition time for every type
+typedef struct
+{
+    uint8_t type;               // RUNNER_ITEM_*
+    int event;
+    apds9960_sample_t sample;
+} apds9960_runner_item_t;
+
+typedef struct apds9960_runner apds9960_runner_t;
+
+// Start acquisition thread servicing p_apds on p_irq assertions and service
+// deadlines. Callbacks of p_apds are replaced while the runner owns it.
+// capacity is rounded up to a power of two, 0 for default.
+apds9960_runner_t
+*apds9960_runner_start(apds9960_t *p_apds, apds9960_irq_t *p_irq,
+    uint32_t capacity);
+
+// Stop thread and free runner, sensor and interrupt source return to the
+// caller with their previous callbacks. Queued items are discarded.
+void
+apds9960_runner_stop(apds9960_runner_t *p_runner);
+
+// eventfd to add to epoll with EPOLLIN, readable while items are queued
+int
+apds9960_runner_get_fd(const apds9960_runner_t *p_runner);
+
+// Take oldest item, returns false when the ring is empty. Call until false
+// after the descriptor became readable.
+bool
+apds9960_runner_pop(apds9960_runner_t *p_runner,
+    apds9960_runner_item_t *p_item);
+
+// Items lost because the ring was full
+uint32_t
+apds9960_runner_get_dropped(const apds9960_runner_t *p_runner);
+
+#endif // APDS9960_LINUX_HOST
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_RUNNER_H_
+
+/* [] END OF FILE */
@@ -0,0 +1,101 @@
+/***************************************************************************//**
+* @file    apds9960_sim.h
+* @version 1.0.0
+*
+* @brief Register-level APDS-9960 simulator for host builds.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef _APDS9960_SIM_H_
+#define _APDS9960_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lib_apds9960.h"
+
+#define APDS9960_SIM_FIFO_DEPTH     32      // Gesture FIFO datasets
+
+// Photodiode indexes, same order as in gesture FIFO
+enum {
+    SIM_DIODE_U,
+    SIM_DIODE_D,
+    SIM_DIODE_L,
+    SIM_DIODE_R,
+    SIM_DIODE_ALL
+};
+
+// Scripted input keyframe, values between keyframes are interpolated
+typedef struct
+{
+    uint32_t time_ms;           // Time from script start
+    apds9960_rgbc_t light;      // Ambient light, counts per 2.78 ms at 1x gain
+    uint8_t diode[SIM_DIODE_ALL];   // Reflected IR per photodiode at 4x gain
+} apds9960_sim_frame_t;
+
+typedef struct
+{
+    uint8_t regs[256];                  // Register file
+    uint8_t reg_ptr;                    // Register address pointer
+    uint8_t fifo[APDS9960_SIM_FIFO_DEPTH][SIM_DIODE_ALL];
+    uint8_t fifo_head;                  // Oldest FIFO dataset
+    uint8_t fifo_level;                 // Number of FIFO datasets
+    uint8_t als_pers_count;             // Consecutive ALS cycles out of range
+    uint8_t prox_pers_count;            // Consecutive prox cycles out of range
+    uint8_t gesture_exit_count;         // Consecutive cycles below GEXTH
+    bool b_is_sleeping;                 // Halted by Sleep After Interrupt
+    bool b_is_manual_clock;             // Time only moves in sim_advance
+    struct timespec clock_origin;       // Real time clock start
+    uint64_t now_us;                    // Simulation time
+    uint64_t cycle_end_us;              // End of current measurement cycle
+    uint8_t cycle_enable;               // ENABLE at start of current cycle
+    const apds9960_sim_frame_t *p_script;
+    size_t script_len;
+    bool b_is_script_looped;
+    uint64_t script_start_us;
+    uint8_t crosstalk[SIM_DIODE_ALL];   // Constant IR added to each diode
+} apds9960_sim_t;
+
+extern const apds9960_transport_t apds9960_transport_sim;
+
+// Create simulated device in power-on reset state. With manual clock the
+// simulation time only advances in apds9960_sim_advance(), otherwise it
+// follows CLOCK_MONOTONIC.
+apds9960_sim_t
+*apds9960_sim_open(bool b_is_manual_clock);
+
+void
+apds9960_sim_close(apds9960_sim_t *p_sim);
+
+// Drive inputs from keyframes, script starts at current simulation time.
+// Frames are not copied and must stay valid while the script runs.
+void
+apds9960_sim_load_script(apds9960_sim_t *p_sim,
+    const apds9960_sim_frame_t *p_frames, size_t frame_count, bool b_is_looped);
+
+// Move manual clock forward and run all measurement cycles due
+void
+apds9960_sim_advance(apds9960_sim_t *p_sim, uint32_t time_us);
+
+// State of the INT pin, true when asserted (driven low)
+bool
+apds9960_sim_is_int_asserted(apds9960_sim_t *p_sim);
+
+// Generate swipe keyframes decoded as GESTURE_DIR_UP/DOWN/LEFT/RIGHT.
+// Returns number of frames written or 0 if p_frames is too small.
+size_t
+apds9960_sim_script_swipe(apds9960_sim_frame_t *p_frames, size_t max_frames,
+    uint32_t start_ms, uint32_t duration_ms, int direction, uint8_t peak);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _APDS9960_SIM_H_
+
+/* [] END OF FILE */
@@ -17,13 +17,25 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-
-#include <applibs/i2c.h>
+#include <time.h>
+#include <sys/types.h>
 
 // Uncomment line below to enable debugging messages
 //#define APDS9960_DEBUG
 
+// Uncomment line below to build for generic Linux hosts (i2c-dev transport)
+// instead of Azure Sphere applibs
+//#define APDS9960_LINUX_HOST
+
+#ifdef APDS9960_LINUX_HOST
+typedef uint32_t I2C_DeviceAddress;
+#else
+#include <applibs/i2c.h>
+#endif
+
 #define APDS9960_I2C_ADDRESS    0x39
 
 // APDS9960 Registers
@@ -80,34 +92,57 @@ extern "C" {
 // Device ID
 #define APDS9960_DEVICE_ID  0xAB    // Part number identification
 
-#define APDS_INIT_ATIME           219     // 103ms
-#define APDS_INIT_WTIME           246     // 27ms
-#define APDS_INIT_PPULSE_PROX     0x87    // 16us, 8 pulses, proximity
-#define APDS_INIT_PPULSE_GEST     0x89    // 16us, 10 pulses, gesture
-#define APDS_INIT_POFFSET_UR      0       // 0 offset
-#define APDS_INIT_POFFSET_DL      0       // 0 offset
-#define APDS_INIT_CONFIG1         0x60    // No 12x wait (WTIME) factor
-#define APDS_INIT_LDRIVE          CONTROL_LDRIVE_100MA
-#define APDS_INIT_PGAIN           CONTROL_PGAIN_4X
-#define APDS_INIT_AGAIN           CONTROL_AGAIN_4X
-#define APDS_INIT_PILT            0       // Low proximity threshold
-#define APDS_INIT_PIHT            50      // High proximity threshold
-#define APDS_INIT_AILT            0xFFFF  // Force interrupt for calibration
-#define APDS_INIT_AIHT            0
-#define APDS_INIT_PERS            0x11    // 2 consecutive prox or ALS for int.
-#define APDS_INIT_CONFIG2         0x01    // No satur interrupts or LED boost  
-#define APDS_INIT_CONFIG3         0       // Enable all photodiodes, no SAI
-#define APDS_INIT_GPENTH          40      // Threshold for entering gesture mode
-#define APDS_INIT_GEXTH           30      // Threshold for exiting gesture mode    
-#define APDS_INIT_GCONF1          0x40    // 4 events for int., 1 for exit
-#define APDS_INIT_GGAIN           GCONF2_GGAIN_4X
-#define APDS_INIT_GLDRIVE         GCONF2_GLDRIVE_100MA
-#define APDS_INIT_GWTIME          GCONF2_GWTIME_2MS
-#define APDS_INIT_GOFFSET         0       // No offset scaling for gesture mode
-#define APDS_INIT_GPULSE          0xC9    // 32us, 10 pulses
-#define APDS_INIT_GCONF3          0       // All diodes active during gesture
-#define APDS_INIT_GIEN            0       // Disable gesture interrupts
+// Register shadow covers configuration registers ENABLE..GCONF4
+// Only the writable ranges ENABLE..CONFIG2 and POFFSET_UR..GCONF4 are kept
+#define APDS9960_SHADOW_FIRST   APDS9960_ENABLE
+#define APDS9960_SHADOW_LAST    APDS9960_GCONF4
+#define APDS9960_SHADOW_SIZE    (APDS9960_SHADOW_LAST - APDS9960_SHADOW_FIRST + 1)
 
+// Register defaults, X(name, value) gives APDS_INIT_<name>. Every one is
+// written by the INIT_FIELDS table of lib_apds9960.c or listed there as
+// applied at runtime, a compile-time check rejects any other.
+#define APDS_INIT_DEFAULTS(X) \
+    X(ATIME,       219)                   /* 103ms */                          \
+    X(WTIME,       246)                   /* 27ms */                           \
+    X(PPULSE_PROX, 0x87)                  /* 16us, 8 pulses, proximity */      \
+    X(PPULSE_GEST, 0x89)                  /* 16us, 10 pulses, gesture */       \
+    X(POFFSET_UR,  0)                     /* 0 offset */                       \
+    X(POFFSET_DL,  0)                     /* 0 offset */                       \
+    X(CONFIG1,     0x60)                  /* No 12x wait (WTIME) factor */     \
+    X(LDRIVE,      CONTROL_LDRIVE_100MA)                                       \
+    X(PGAIN,       CONTROL_PGAIN_4X)                                           \
+    X(AGAIN,       CONTROL_AGAIN_4X)                                           \
+    X(PILT,        0)                     /* Low proximity threshold */        \
+    X(PIHT,        50)                    /* High proximity threshold */       \
+    X(AILT,        0xFFFF)                /* Force int. for calibration */     \
+    X(AIHT,        0)                                                          \
+    X(PERS,        0x11)                  /* 2 prox or ALS cycles for int. */  \
+    X(CONFIG2,     0x01)                  /* No satur interrupts, LED boost */ \
+    X(CONFIG3,     0)                     /* Enable all photodiodes, no SAI */ \
+    X(GPENTH,      40)                    /* Gesture mode entry threshold */   \
+    X(GEXTH,       30)                    /* Gesture mode exit threshold */    \
+    X(GCONF1,      0x40)                  /* 4 events for int., 1 for exit */  \
+    X(GGAIN,       GCONF2_GGAIN_4X)                                            \
+    X(GLDRIVE,     GCONF2_GLDRIVE_100MA)                                       \
+    X(GWTIME,      GCONF2_GWTIME_2MS)                                          \
+    X(GOFFSET,     0)                     /* No gesture offset scaling */      \
+    X(GPULSE,      0xC9)                  /* 32us, 10 pulses */                \
+    X(GCONF3,      0)                     /* All diodes active in gesture */   \
+    X(GIEN,        0)                     /* Disable gesture interrupts */
+
+#define APDS9960_ALS_CYCLE_US       2780    // ALS integration step (ATIME)
+#define APDS9960_ALS_CYCLE_COUNTS   1025    // Full scale counts per step
+#define APDS9960_GFIFO_CHUNK_DEFAULT    8   // Gesture FIFO burst read bytes
+
+
+// ALS colour sample, all channels from the same integration cycle
+typedef struct
+{
+    uint16_t clear;
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+} apds9960_rgbc_t;
 
 // ENABLE Register bitfields
 typedef struct
@@ -374,6 +409,13 @@ typedef struct
     };
 } apds9960_gconf4_t;
 
+// APDS_INIT_* constants, after the field values they use
+#define APDS_INIT_ENUM(name, value)     APDS_INIT_##name = (value),
+
+enum {
+    APDS_INIT_DEFAULTS(APDS_INIT_ENUM)
+};
+
 // GSTATUS Register bitfields
 typedef struct {
     union {
@@ -386,15 +428,16 @@ typedef struct {
     };
 } apds9960_gstatus_t;
 
+// Streaming gesture decoder data, constant size for any gesture length
 typedef struct
 {
-    uint8_t u[32];      // Data buffer Up
-    uint8_t d[32];      // Data buffer Down
-    uint8_t l[32];      // Data buffer Left
-    uint8_t r[32];      // Data buffer Right
-    uint8_t dset_count; // Gesture datasets count
-    uint8_t thold_in;   // Gesture Threshold In
-    uint8_t thold_out;  // Gesture Threshold Out
+    uint8_t first[4];       // First U/D/L/R dataset above Out threshold
+    uint8_t last[4];        // Last U/D/L/R dataset above Out threshold
+    bool b_has_first;       // First dataset has been found
+    bool b_is_closed;       // Dataset below threshold followed the last one
+    int ud_ratio_prev;      // UD ratio of last dataset at previous step
+    int lr_ratio_prev;      // LR ratio of last dataset at previous step
+    uint32_t dset_count;    // Gesture datasets count
 } apds9960_gesture_data_t;
 
 typedef struct
@@ -411,14 +454,280 @@ typedef struct
     int far;
 } apds9960_gesture_count_t;
 
+// Gesture decoder tuning parameters
+typedef struct
+{
+    uint8_t thold_out;      // Dataset counts when all U/D/L/R are above
+    int sens_1;             // UD/LR ratio change of a directional gesture
+    int sens_2;             // Step ratio change still taken as Near-Far
+    int near_count;         // Still steps needed for Near-Far gesture
+    int far_count;          // Moving steps needed for Near-Far gesture
+} apds9960_gesture_params_t;
+
+typedef struct
+{
+    apds9960_gesture_params_t params;
+    apds9960_gesture_data_t data;
+    apds9960_gesture_delta_t delta;
+    apds9960_gesture_count_t count;
+    int state;
+    int motion;
+} apds9960_gesture_decoder_t;
+
+#define APDS9960_GESTURE_EVENTS_MAX     16  // Gesture event ring capacity
+
+// Decoded gesture
+typedef struct
+{
+    int gesture;                // Gesture direction GESTURE_DIR_*
+    struct timespec timestamp;  // Decode time, CLOCK_MONOTONIC
+    uint32_t dset_count;        // Datasets processed for this gesture
+    uint32_t duration_ms;       // Time from gesture start to decode
+} apds9960_gesture_event_t;
+
+// Fixed-capacity gesture event ring, oldest events are overwritten
+typedef struct
+{
+    apds9960_gesture_event_t events[APDS9960_GESTURE_EVENTS_MAX];
+    uint8_t head;               // Index of oldest event
+    uint8_t count;              // Number of stored events
+    uint32_t dropped;           // Events overwritten before being read
+} apds9960_gesture_events_t;
+
+// Single message of a combined I2C transfer
+typedef struct
+{
+    uint8_t *p_buf;     // Message data buffer
+    uint32_t len;       // Message data length
+    bool b_is_read;     // Read (true) or write (false) message
+} apds9960_i2c_msg_t;
+
+// I2C bus transport operations
+// All operations return number of bytes transferred or -1 on error.
+typedef struct
+{
+    const char *name;
+
+    ssize_t (*read)(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+        uint8_t *p_data, size_t data_len);
+
+    ssize_t (*write)(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+        const uint8_t *p_data, size_t data_len);
+
+    ssize_t (*write_then_read)(void *p_ctx, int i2c_fd,
+        I2C_DeviceAddress i2c_addr, const uint8_t *p_wr_data, size_t wr_len,
+        uint8_t *p_rd_data, size_t rd_len);
+
+    // Submit several messages as one combined transaction (repeated START)
+    ssize_t (*transfer)(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+        apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+} apds9960_transport_t;
+
+#ifdef APDS9960_LINUX_HOST
+extern const apds9960_transport_t apds9960_transport_i2cdev;
+#define APDS9960_TRANSPORT_DEFAULT  (&apds9960_transport_i2cdev)
+#else
+extern const apds9960_transport_t apds9960_transport_applibs;
+#define APDS9960_TRANSPORT_DEFAULT  (&apds9960_transport_applibs)
+#endif
+
+// Gesture FIFO batch hook, called for every FIFO read in gesture poll step.
+// p_datasets holds dataset_count U/D/L/R datasets.
+typedef void (*apds9960_gesture_hook_t)(void *p_ctx,
+    const struct timespec *p_now, apds9960_gstatus_t gstatus,
+    uint8_t dataset_count, const uint8_t *p_datasets);
+
+// Status and data registers STATUS..PDATA read in one burst
+typedef struct
+{
+    apds9960_status_t status;   // AVALID/PVALID mark data of a new cycle
+    apds9960_rgbc_t rgbc;
+    uint8_t proximity;
+    uint8_t als_gain;           // ALS gain factor of colour data, 1 to 64
+    uint32_t als_time_us;       // ALS integration time of colour data
+    struct timespec timestamp;  // Read time, CLOCK_MONOTONIC
+} apds9960_sample_t;
+
+// ALS auto-ranging parameters
+typedef struct
+{
+    uint16_t resolution;    // Full scale clear counts needed, sets shortest ATIME
+    uint16_t cycles_max;    // Longest integration in ATIME steps, 1 to 256
+    uint8_t low_pct;        // Raise sensitivity below this % of full scale
+    uint8_t high_pct;       // Lower sensitivity above this % of full scale
+} apds9960_als_autorange_params_t;
+
+typedef struct
+{
+    apds9960_als_autorange_params_t params;
+    bool b_is_enabled;
+    bool b_is_settling;     // Next sample was integrated across range change
+    bool b_is_cpsat_seen;   // Sticky CPSAT acted upon, not cleared yet
+    uint16_t cycles_min;    // Integration steps meeting resolution
+} apds9960_als_autorange_t;
+
+// ALS wake-on-change, threshold window follows the clear channel
+typedef struct
+{
+    bool b_is_enabled;
+    uint8_t band_pct;       // Window half-width, % of clear reading
+} apds9960_als_wake_t;
+
+// Proximity presence detection parameters, in PDATA counts
+typedef struct
+{
+    uint8_t approach_delta; // Reading above baseline reporting approach
+    uint8_t leave_delta;    // Reading above baseline below which target left
+    uint8_t drift_band;     // Baseline follows readings leaving this band
+    uint8_t ppers;          // PERS.PPERS, cycles out of band for interrupt
+} apds9960_presence_params_t;
+
+typedef struct
+{
+    apds9960_presence_params_t params;
+    bool b_is_enabled;
+    bool b_is_present;
+    bool b_is_baseline_valid;   // Baseline taken from first interrupt
+    uint8_t baseline;           // No-target proximity level
+    bool b_is_rise_pending;     // Reading above drift band, rise at rise_at
+    struct timespec rise_at;    // Earliest next baseline rise
+} apds9960_presence_t;
+
+// Sleep-after-interrupt mode state and statistics. The device is asleep
+// from the service seeing INT asserted until the interrupt is cleared.
+typedef struct
+{
+    bool b_is_enabled;
+    bool b_is_asleep;
+    bool b_is_held;                         // Clear held back for hold_ms
+    bool b_is_gien;                         // Application GIEN
+    uint8_t enable_int;                     // Application AIEN, PIEN
+    uint32_t hold_ms;                       // Minimum sleep per interrupt
+    apds9960_status_t held_status;          // Sources to clear on wake
+    struct timespec sleep_start;            // CLOCK_MONOTONIC
+    struct timespec wake;                   // CLOCK_MONOTONIC
+    uint32_t sleeps;
+    uint64_t asleep_us;
+    uint64_t awake_us;
+} apds9960_sai_t;
+
+// Every writable register field, see the register types above. Byte
+// registers are plain values, thresholds are 16-bit.
+typedef struct
+{
+    apds9960_enable_t enable;
+    uint8_t atime;
+    uint8_t wtime;
+    uint16_t ailt;
+    uint16_t aiht;
+    uint8_t pilt;
+    uint8_t piht;
+    apds9960_pers_t pers;
+    apds9960_config1_t config1;
+    apds9960_ppulse_t ppulse;
+    apds9960_control_t control;
+    apds9960_config2_t config2;
+    uint8_t poffset_ur;
+    uint8_t poffset_dl;
+    apds9960_config3_t config3;
+    uint8_t gpenth;
+    uint8_t gexth;
+    apds9960_gconf1_t gconf1;
+    apds9960_gconf2_t gconf2;
+    uint8_t goffset_u;
+    uint8_t goffset_d;
+    apds9960_gpulse_t gpulse;
+    uint8_t goffset_l;
+    uint8_t goffset_r;
+    apds9960_gconf3_t gconf3;
+    apds9960_gconf4_t gconf4;               // GFIFO_CLR set clears FIFO
+} apds9960_config_t;
+
+// Photodiode offsets found by calibration, raw sign-magnitude register
+// values. Plain bytes, may be stored as is and reapplied after open.
+typedef struct
+{
+    uint8_t poffset_ur;
+    uint8_t poffset_dl;
+    uint8_t goffset_u;
+    uint8_t goffset_d;
+    uint8_t goffset_l;
+    uint8_t goffset_r;
+} apds9960_offsets_t;
+
+// Sample rates in millihertz, 0 when function is off
+typedef struct
+{
+    uint32_t als_mhz;
+    uint32_t prox_mhz;
+    uint32_t gesture_mhz;   // FIFO datasets while a gesture is in progress
+} apds9960_rates_t;
+
+enum {
+    SCHED_PHASE_ALS,        // ALS and proximity cycle
+    SCHED_PHASE_PROX,       // Proximity cycles only
+    SCHED_PHASE_ALL
+};
+
+// Mode scheduler plan and state
+typedef struct
+{
+    apds9960_rates_t requested;
+    apds9960_rates_t achieved;              // Estimated from register timing
+    bool b_is_enabled;
+    bool b_is_multiplexed;                  // Host switches phases
+    uint8_t phase;                          // Current SCHED_PHASE_*
+    uint8_t phase_enable[SCHED_PHASE_ALL];  // ENABLE of each phase
+    uint32_t period_us;                     // ALS phase start to next one
+    uint32_t prox_cycle_us;                 // Cycle of proximity phase
+    uint32_t pulse_us;                      // Proximity measurement time
+    struct timespec phase_end;              // CLOCK_MONOTONIC
+    uint32_t phase_switches;
+} apds9960_schedule_t;
+
+// Interrupt service callbacks, NULL members are skipped
+typedef struct
+{
+    // ALS interrupt (AINT), colour sample of the interrupting cycle
+    void (*als)(void *p_ctx, const apds9960_sample_t *p_sample);
+
+    // Proximity interrupt (PINT)
+    void (*proximity)(void *p_ctx, uint8_t proximity);
+
+    // Gesture ended, whole gesture sequence is in the gesture event ring
+    void (*gesture)(void *p_ctx, int gesture);
+
+    // Presence detection event PRESENCE_EVENT_*
+    void (*presence)(void *p_ctx, int event, uint8_t proximity);
+
+    // Clear photodiode (CPSAT) or proximity/gesture (PGSAT) saturation
+    void (*saturation)(void *p_ctx, apds9960_status_t status);
+} apds9960_callbacks_t;
+
 typedef struct {
     int i2c_fd;                                 // I2C interface file descriptor
     I2C_DeviceAddress i2c_addr;                 // I2C device address
-    apds9960_gesture_data_t gesture_data;
-    apds9960_gesture_delta_t gesture_delta;
-    apds9960_gesture_count_t gesture_count;
-    int gesture_state;
-    int gesture_motion;
+    const apds9960_transport_t *p_transport;    // I2C bus transport
+    void *p_transport_ctx;                      // Transport private context
+    uint8_t reg_shadow[APDS9960_SHADOW_SIZE];   // Config registers copy
+    apds9960_rgbc_t als_sample;                 // Last ALS sample read
+    uint8_t als_sample_fresh;                   // Channels not yet consumed
+    struct timespec als_sample_time;            // Read time of ALS sample
+    uint8_t gesture_fifo_chunk;                 // FIFO burst size in bytes
+    apds9960_gesture_decoder_t gesture_decoder;
+    bool b_is_gesture_active;                   // Gesture being collected
+    struct timespec gesture_start;              // Current gesture start
+    int gesture_last_event;                     // Last event of this gesture
+    apds9960_gesture_events_t gesture_events;   // Decoded gestures
+    apds9960_gesture_hook_t p_gesture_hook;     // FIFO batch hook
+    void *p_gesture_hook_ctx;                   // FIFO batch hook context
+    apds9960_callbacks_t callbacks;             // Interrupt service callbacks
+    void *p_callbacks_ctx;                      // Interrupt callbacks context
+    apds9960_als_autorange_t als_autorange;     // ALS gain/ATIME controller
+    apds9960_als_wake_t als_wake;               // ALS threshold window
+    apds9960_presence_t presence;               // Proximity threshold band
+    apds9960_schedule_t schedule;               // Mode scheduler
+    apds9960_sai_t sai;                         // Sleep after interrupt
 } apds9960_t;
 
 enum {
@@ -432,6 +741,12 @@ enum {
     GESTURE_DIR_ALL
 };
 
+enum {
+    PRESENCE_EVENT_NONE,
+    PRESENCE_EVENT_APPROACH,
+    PRESENCE_EVENT_LEAVE
+};
+
 enum {
     GESTURE_STATE_NA,
     GESTURE_STATE_NEAR,
@@ -442,9 +757,17 @@ enum {
 apds9960_t
 *apds9960_open(int i2c_fd, I2C_DeviceAddress i2c_addr);
 
+apds9960_t
+*apds9960_open_transport(const apds9960_transport_t *p_transport,
+    void *p_transport_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr);
+
 void
 apds9960_close(apds9960_t *p_apds);
 
+// Reload register shadow from device, use when device may have been reset
+bool
+apds9960_shadow_resync(apds9960_t *p_apds);
+
 // apds9960_als
 
 bool
@@ -453,6 +776,12 @@ apds9960_als_enable(apds9960_t *p_apds, bool b_are_interrupts_enabled);
 bool
 apds9960_als_disable(apds9960_t *p_apds);
 
+// Read all colour channels in one transaction
+bool
+apds9960_als_read_rgbc(apds9960_t *p_apds, apds9960_rgbc_t *p_rgbc);
+
+// Per-channel readers return channels of the last sample read, a new sample
+// is read only when the requested channel has already been returned
 bool
 apds9960_als_read_clear(apds9960_t *p_apds, uint16_t *value_clear);
 
@@ -465,6 +794,32 @@ apds9960_als_read_green(apds9960_t *p_apds, uint16_t *value_green);
 bool
 apds9960_als_read_blue(apds9960_t *p_apds, uint16_t *value_blue);
 
+// Fill p_params with default auto-ranging parameters
+void
+apds9960_als_autorange_params_default(apds9960_als_autorange_params_t *p_params);
+
+// Adjust AGAIN and ATIME between samples read by apds9960_read_all().
+// Integration time is the shortest one meeting resolution, it is extended
+// only when gain is already at maximum. NULL p_params sets defaults.
+bool
+apds9960_als_autorange_enable(apds9960_t *p_apds,
+    const apds9960_als_autorange_params_t *p_params);
+
+// Stop auto-ranging, current AGAIN and ATIME are kept
+void
+apds9960_als_autorange_disable(apds9960_t *p_apds);
+
+// Wake-on-change: ALS interrupts only when clear channel leaves a window of
+// +-band_pct % around the last interrupting reading for apers (PERS.APERS,
+// 0 to 15) consecutive cycles. Enables ALS with interrupt, window is
+// re-centred by apds9960_service_interrupt().
+bool
+apds9960_als_wake_enable(apds9960_t *p_apds, uint8_t band_pct, uint8_t apers);
+
+// Stop re-centring, current window and AIEN are kept
+void
+apds9960_als_wake_disable(apds9960_t *p_apds);
+
 // apds9960_proximity
 
 bool
@@ -476,6 +831,27 @@ apds9960_proximity_disable(apds9960_t *p_apds);
 bool
 apds9960_proximity_read(apds9960_t *p_apds, uint8_t *p_value_proximity);
 
+// Fill p_params with default presence detection parameters
+void
+apds9960_presence_params_default(apds9960_presence_params_t *p_params);
+
+// Presence detection: PILT/PIHT hold a band around the no-target baseline,
+// so proximity interrupts only on approach, leave and baseline drift.
+// Falling baseline is followed at once, rising by one count per second
+// through the apds9960_service_interrupt() deadline. A jump beyond
+// approach_delta while absent (e.g. new cover glass crosstalk) is approach
+// and needs offset calibration.
+// Enables proximity with interrupt, first interrupt takes the baseline,
+// keep the field clear. apds9960_service_interrupt() moves the band and
+// calls the presence callback. NULL p_params sets defaults.
+bool
+apds9960_presence_enable(apds9960_t *p_apds,
+    const apds9960_presence_params_t *p_params);
+
+// Stop moving the band, current PILT/PIHT and PIEN are kept
+void
+apds9960_presence_disable(apds9960_t *p_apds);
+
 // apds9960_gesture
 
 bool
@@ -487,9 +863,173 @@ apds9960_gesture_disable(apds9960_t *p_apds);
 bool
 apds9960_gesture_is_valid(apds9960_t *p_apds, bool *p_value);
 
+// Blocking gesture read, returns after the gesture has ended
 int
 apds9960_gesture_read(apds9960_t *p_apds);
 
+// Non-blocking gesture read step for event loops. Call when the sensor
+// interrupt fires and again at p_next_deadline (CLOCK_MONOTONIC) while it is
+// nonzero. p_now may be NULL to read the clock internally.
+// Returns decoded gesture once it has ended, GESTURE_DIR_NONE while in
+// progress or -1 on error.
+int
+apds9960_gesture_poll(apds9960_t *p_apds, const struct timespec *p_now,
+    struct timespec *p_next_deadline);
+
+// Copy up to max_events decoded gestures, oldest first, out of the event
+// ring. Returns number of events copied.
+size_t
+apds9960_gesture_events_read(apds9960_t *p_apds,
+    apds9960_gesture_event_t *p_events, size_t max_events);
+
+// Set hook receiving raw FIFO batches, e.g. apds9960_capture_hook().
+// NULL p_hook removes the hook.
+void
+apds9960_gesture_set_hook(apds9960_t *p_apds, apds9960_gesture_hook_t p_hook,
+    void *p_ctx);
+
+// Fill p_params with built-in decoder parameters
+void
+apds9960_gesture_params_default(apds9960_gesture_params_t *p_params);
+
+// Replace decoder parameters of device, NULL restores defaults.
+// Gesture in progress is discarded.
+void
+apds9960_gesture_set_params(apds9960_t *p_apds,
+    const apds9960_gesture_params_t *p_params);
+
+// Gesture decoder working without device, e.g. for capture replay.
+// Init sets parameters (NULL for defaults), reset only clears gesture state.
+void
+apds9960_gesture_decoder_init(apds9960_gesture_decoder_t *p_dec,
+    const apds9960_gesture_params_t *p_params);
+
+void
+apds9960_gesture_decoder_reset(apds9960_gesture_decoder_t *p_dec);
+
+// Feed one FIFO batch of dataset_count U/D/L/R datasets. b_is_valid is
+// GVALID of the batch, false ends the gesture. Returns decoded gesture or
+// GESTURE_DIR_NONE, p_dset_count (may be NULL) receives number of datasets
+// of the gesture.
+int
+apds9960_gesture_decoder_feed(apds9960_gesture_decoder_t *p_dec,
+    bool b_is_valid, const uint8_t *p_datasets, uint8_t dataset_count,
+    uint32_t *p_dset_count);
+
+// Set maximum FIFO burst read size, multiple of 4 bytes up to 128
+bool
+apds9960_gesture_set_fifo_chunk(apds9960_t *p_apds, uint8_t chunk_size);
+
+// Find and set the largest FIFO burst size delivering consistent data.
+// Runs the gesture engine for a moment, keep the sensor field still. Falls
+// back to 4 bytes when no larger size passes.
+bool
+apds9960_gesture_fifo_selftest(apds9960_t *p_apds, uint8_t *p_chunk_size);
+
+// apds9960_config
+
+// Values loaded by apds9960_open(), all functions off
+void
+apds9960_config_default(apds9960_config_t *p_config);
+
+// Current configuration, from register shadow
+void
+apds9960_config_get(const apds9960_t *p_apds, apds9960_config_t *p_config);
+
+// Write registers differing from current configuration. Adjacent changed
+// registers are written in one burst, gaps of unchanged ones are bridged
+// when cheaper than another transaction. Engines turned off stop before
+// the other registers change, engines turned on start after. Library state
+// of the per-function helpers is not updated.
+bool
+apds9960_config_apply(apds9960_t *p_apds, const apds9960_config_t *p_config);
+
+// apds9960_calibration
+
+// Cancel no-target crosstalk (e.g. cover glass) with POFFSET_UR/DL and
+// GOFFSET_U/D/L/R. Each offset is the largest one leaving a small positive
+// reading, averaged over cycles (1 to 32) measurements per step, at the
+// current gain and LED settings. Keep the field clear. Offsets stay applied
+// and are returned in p_offsets. Returns false on error or when a residual
+// reading stays high after calibration, p_offsets is filled in that case.
+bool
+apds9960_offsets_calibrate(apds9960_t *p_apds, uint8_t cycles,
+    apds9960_offsets_t *p_offsets);
+
+// Write stored offsets, up to 3 transactions
+bool
+apds9960_offsets_apply(apds9960_t *p_apds, const apds9960_offsets_t *p_offsets);
+
+// Offsets currently set
+void
+apds9960_offsets_get(const apds9960_t *p_apds, apds9960_offsets_t *p_offsets);
+
+// apds9960_schedule
+
+// Plan ALS, proximity and gesture from requested rates and start it. The
+// scheduler owns ENABLE engine bits, WTIME, WLONG, PPULSE, LED_BOOST and
+// GWTIME, do not use the per-function enables alongside it. When ALS
+// integration is too long for the proximity rate, cycles alternate between
+// an ALS phase and a proximity phase switched by apds9960_schedule_step().
+// p_achieved (may be NULL) receives estimated rates, ALS and proximity
+// rates hold outside gestures. All rates zero powers the engines down.
+bool
+apds9960_schedule_set(apds9960_t *p_apds, const apds9960_rates_t *p_rates,
+    apds9960_rates_t *p_achieved);
+
+// Switch phase when due, one ENABLE write. Call again at p_next_deadline
+// (CLOCK_MONOTONIC) while it is nonzero. p_now may be NULL to read the
+// clock internally.
+bool
+apds9960_schedule_step(apds9960_t *p_apds, const struct timespec *p_now,
+    struct timespec *p_next_deadline);
+
+// apds9960_sai
+
+// Sleep after interrupt: set CONFIG3.SAI and interrupt enables of running
+// engines. The device stops cycling when INT asserts and
+// apds9960_service_interrupt() wakes it with the clear register of the
+// serviced sources, hold_ms (0 for none) after it has seen the interrupt.
+// Held wakes are reported through p_next_deadline of the service.
+bool
+apds9960_sai_enable(apds9960_t *p_apds, uint32_t hold_ms);
+
+// Clear SAI and restore interrupt enables of the application
+bool
+apds9960_sai_disable(apds9960_t *p_apds);
+
+// apds9960_interrupt
+
+// Read status, colour and proximity data in a single 10 byte transaction.
+// With ALS auto-ranging enabled the range is adjusted for next samples, a
+// sample integrated across range change is returned with AVALID cleared.
+// Interrupts are not cleared, that is left to apds9960_service_interrupt().
+bool
+apds9960_read_all(apds9960_t *p_apds, apds9960_sample_t *p_sample);
+
+// Set callbacks of apds9960_service_interrupt(), NULL removes all
+void
+apds9960_set_callbacks(apds9960_t *p_apds,
+    const apds9960_callbacks_t *p_callbacks, void *p_ctx);
+
+// Service sensor interrupt: read STATUS and data registers in one burst,
+// call callbacks of pending sources and clear only those sources.
+// Call when INT asserts and again at p_next_deadline (CLOCK_MONOTONIC)
+// while it is nonzero, a gesture or presence baseline rise is then in
+// progress. p_next_deadline may be NULL when neither gesture engine nor
+// presence detection is used.
+bool
+apds9960_service_interrupt(apds9960_t *p_apds,
+    struct timespec *p_next_deadline);
+
+#ifdef APDS9960_LINUX_HOST
+// apds9960_transport_i2cdev
+
+// Open /dev/i2c-<bus_number>, returns file descriptor or -1 on error
+int
+apds9960_i2cdev_open(unsigned int bus_number);
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -1,13 +1,52 @@
 
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
 #include "lib_apds9960.h"
 #include "apds9960_common.h"
 
+#define ALS_CHANNEL_CLEAR   0
+#define ALS_CHANNEL_RED     1
+#define ALS_CHANNEL_GREEN   2
+#define ALS_CHANNEL_BLUE    3
+#define ALS_CHANNELS_ALL    0x0F
+
+#define ALS_AUTORANGE_RESOLUTION    4096    // 12 bits of clear channel
+#define ALS_AUTORANGE_CYCLES_MAX    256     // 712 ms
+#define ALS_AUTORANGE_LOW_PCT       10
+#define ALS_AUTORANGE_HIGH_PCT      80
+
+#define ALS_WAKE_DELTA_MIN          2       // Counts, ignores ADC noise
+#define ALS_WAKE_APERS_MAX          15
+
 /*******************************************************************************
 * Forward declarations of private functions
 *******************************************************************************/
 
+static bool
+als_sample_update(apds9960_t *p_apds);
+
+static bool
+als_read_channel(apds9960_t *p_apds, uint8_t channel, uint16_t *p_value);
+
+static void
+als_range_down(const apds9960_als_autorange_t *p_ar, uint8_t *p_again,
+    uint16_t *p_cycles);
+
+static void
+als_range_up(const apds9960_als_autorange_t *p_ar, uint8_t *p_again,
+    uint16_t *p_cycles);
+
+static bool
+als_range_set(apds9960_t *p_apds, uint8_t again, uint16_t cycles);
+
+static uint32_t
+als_full_scale(uint16_t cycles);
+
+static bool
+als_window_set(apds9960_t *p_apds, uint16_t low, uint16_t high);
+
 
 /*******************************************************************************
 * Global variables
@@ -24,10 +63,14 @@ apds9960_als_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
     bool b_is_all_ok = false;
 
     // Set CONTROL register
-    // -- AGAIN: init value
+    // -- AGAIN: init value, unless auto-ranging owns it
     apds9960_control_t reg_control;
-    b_is_all_ok = reg_read8(p_apds, APDS9960_CONTROL, &reg_control.byte);
-    if (b_is_all_ok)
+    reg_control.byte = reg_shadow8(p_apds, APDS9960_CONTROL);
+    if (p_apds->als_autorange.b_is_enabled)
+    {
+        b_is_all_ok = true;
+    }
+    else
     {
         reg_control.AGAIN = APDS_INIT_AGAIN;
         b_is_all_ok = reg_write8(p_apds, APDS9960_CONTROL, &reg_control.byte);
@@ -40,14 +83,11 @@ apds9960_als_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
     if (b_is_all_ok)
     {
         apds9960_enable_t reg_enable;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        if (b_is_all_ok)
-        {
-            reg_enable.PON = 1;
-            reg_enable.AEN = 1;
-            reg_enable.AIEN = b_is_interrupt_enabled;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        }
+        reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+        reg_enable.PON = 1;
+        reg_enable.AEN = 1;
+        reg_enable.AIEN = b_is_interrupt_enabled;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
     }
 
     if (!b_is_all_ok)
@@ -65,14 +105,11 @@ apds9960_als_disable(apds9960_t *p_apds)
     // -- AEN: ALS Disable
     // -- AIEN: ALS Interrupt Disable
     apds9960_enable_t reg_enable;
-    bool b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    reg_enable.AEN = 0;
+    reg_enable.AIEN = 0;
 
-    if (b_is_all_ok)
-    {
-        reg_enable.AEN = 0;
-        reg_enable.AIEN = 0;
-        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-    }
+    bool b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
 
     if (!b_is_all_ok)
     {
@@ -83,24 +120,28 @@ apds9960_als_disable(apds9960_t *p_apds)
 }
 
 bool
-apds9960_als_read_clear(apds9960_t *p_apds, uint16_t *value_clear)
+apds9960_als_read_rgbc(apds9960_t *p_apds, apds9960_rgbc_t *p_rgbc)
 {
-    bool b_is_all_ok = false;
-    uint8_t reg_value;
+    bool b_is_all_ok = als_sample_update(p_apds);
 
-    *value_clear = 0;
-
-    b_is_all_ok = reg_read8(p_apds, APDS9960_CDATAH, &reg_value);
     if (b_is_all_ok)
     {
-        *value_clear = (uint16_t)(reg_value << 8);
-        b_is_all_ok = reg_read8(p_apds, APDS9960_CDATAL, &reg_value);
-        if (b_is_all_ok)
-        {
-            *value_clear = (uint16_t)(*value_clear | reg_value);
-        }
+        *p_rgbc = p_apds->als_sample;
+        p_apds->als_sample_fresh = 0;
+    }
+    else
+    {
+        memset(p_rgbc, 0, sizeof(apds9960_rgbc_t));
     }
 
+    return b_is_all_ok;
+}
+
+bool
+apds9960_als_read_clear(apds9960_t *p_apds, uint16_t *value_clear)
+{
+    bool b_is_all_ok = als_read_channel(p_apds, ALS_CHANNEL_CLEAR, value_clear);
+
     if (!b_is_all_ok)
     {
         ERROR("Error reading ALS clear light level.", __FUNCTION__);
@@ -112,88 +153,409 @@ apds9960_als_read_clear(apds9960_t *p_apds, uint16_t *value_clear)
 bool
 apds9960_als_read_red(apds9960_t *p_apds, uint16_t *value_red)
 {
-    bool b_is_all_ok = false;
-    uint8_t reg_value;
+    bool b_is_all_ok = als_read_channel(p_apds, ALS_CHANNEL_RED, value_red);
 
-    *value_red = 0;
+    if (!b_is_all_ok)
+    {
+        ERROR("Error reading ALS red light level.", __FUNCTION__);
+    }
 
-    b_is_all_ok = reg_read8(p_apds, APDS9960_RDATAH, &reg_value);
-    if (b_is_all_ok)
+    return b_is_all_ok;
+}
+
+bool
+apds9960_als_read_green(apds9960_t *p_apds, uint16_t *value_green)
+{
+    bool b_is_all_ok = als_read_channel(p_apds, ALS_CHANNEL_GREEN, value_green);
+
+    if (!b_is_all_ok)
     {
-        *value_red = (uint16_t)(reg_value << 8);
-        b_is_all_ok = reg_read8(p_apds, APDS9960_RDATAL, &reg_value);
-        if (b_is_all_ok)
-        {
-            *value_red = (uint16_t)(*value_red | reg_value);
-        }
+        ERROR("Error reading ALS green light level.", __FUNCTION__);
     }
 
+    return b_is_all_ok;
+}
+
+bool
+apds9960_als_read_blue(apds9960_t *p_apds, uint16_t *value_blue)
+{
+    bool b_is_all_ok = als_read_channel(p_apds, ALS_CHANNEL_BLUE, value_blue);
+
     if (!b_is_all_ok)
     {
-        ERROR("Error reading ALS red light level.", __FUNCTION__);
+        ERROR("Error reading ALS blue light level.", __FUNCTION__);
     }
 
     return b_is_all_ok;
 }
 
+void
+apds9960_als_autorange_params_default(apds9960_als_autorange_params_t *p_params)
+{
+    p_params->resolution = ALS_AUTORANGE_RESOLUTION;
+    p_params->cycles_max = ALS_AUTORANGE_CYCLES_MAX;
+    p_params->low_pct = ALS_AUTORANGE_LOW_PCT;
+    p_params->high_pct = ALS_AUTORANGE_HIGH_PCT;
+}
+
 bool
-apds9960_als_read_green(apds9960_t *p_apds, uint16_t *value_green)
+apds9960_als_autorange_enable(apds9960_t *p_apds,
+    const apds9960_als_autorange_params_t *p_params)
 {
+    apds9960_als_autorange_t *p_ar = &p_apds->als_autorange;
     bool b_is_all_ok = false;
-    uint8_t reg_value;
 
-    *value_green = 0;
+    if (p_params)
+    {
+        p_ar->params = *p_params;
+    }
+    else
+    {
+        apds9960_als_autorange_params_default(&p_ar->params);
+    }
 
-    b_is_all_ok = reg_read8(p_apds, APDS9960_GDATAH, &reg_value);
-    if (b_is_all_ok)
+    // Largest range step is 4x gain, limits closer than that would oscillate
+    if ((p_ar->params.cycles_max < 1) || (p_ar->params.cycles_max > 256) ||
+        (p_ar->params.high_pct > 100) ||
+        (p_ar->params.low_pct * 4 >= p_ar->params.high_pct))
     {
-        *value_green = (uint16_t)(reg_value << 8);
-        b_is_all_ok = reg_read8(p_apds, APDS9960_GDATAL, &reg_value);
-        if (b_is_all_ok)
+        ERROR("Invalid auto-ranging parameters.", __FUNCTION__);
+    }
+    else
+    {
+        // Shortest integration giving required full scale
+        p_ar->cycles_min = (uint16_t)((p_ar->params.resolution +
+            APDS9960_ALS_CYCLE_COUNTS - 1) / APDS9960_ALS_CYCLE_COUNTS);
+        if (p_ar->cycles_min < 1)
+        {
+            p_ar->cycles_min = 1;
+        }
+        else if (p_ar->cycles_min > p_ar->params.cycles_max)
         {
-            *value_green = (uint16_t)(*value_green | reg_value);
+            p_ar->cycles_min = p_ar->params.cycles_max;
         }
+
+        // Start in the middle of the range
+        p_ar->b_is_cpsat_seen = false;
+        b_is_all_ok = als_range_set(p_apds, CONTROL_AGAIN_4X,
+            p_ar->cycles_min);
+    }
+
+    p_ar->b_is_enabled = b_is_all_ok;
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_als_autorange_disable(apds9960_t *p_apds)
+{
+    p_apds->als_autorange.b_is_enabled = false;
+}
+
+bool
+als_autorange_update(apds9960_t *p_apds, apds9960_sample_t *p_sample)
+{
+    apds9960_als_autorange_t *p_ar = &p_apds->als_autorange;
+    bool b_is_all_ok = true;
+    uint64_t clear = p_sample->rgbc.clear;
+    uint32_t full_scale;
+    uint8_t again;
+    uint8_t new_again;
+    uint16_t cycles;
+    uint16_t new_cycles;
+
+    if (!p_ar->b_is_enabled || !p_sample->status.AVALID)
+    {
+        return true;
+    }
+
+    // Sample of the cycle running while range changed has mixed settings
+    if (p_ar->b_is_settling)
+    {
+        p_ar->b_is_settling = false;
+        p_sample->status.AVALID = 0;
+        return true;
+    }
+
+    apds9960_control_t reg_control;
+    reg_control.byte = reg_shadow8(p_apds, APDS9960_CONTROL);
+    again = new_again = reg_control.AGAIN;
+    cycles = new_cycles = (uint16_t)(256 - reg_shadow8(p_apds, APDS9960_ATIME));
+    full_scale = als_full_scale(cycles);
+
+    // CPSAT stays set until the service routine clears it, a saturation
+    // already acted upon must not lower the range again
+    bool b_is_saturated = p_sample->status.CPSAT && !p_ar->b_is_cpsat_seen;
+    p_ar->b_is_cpsat_seen = p_sample->status.CPSAT;
+
+    if (b_is_saturated ||
+        (clear * 100 >= (uint64_t)full_scale * p_ar->params.high_pct))
+    {
+        als_range_down(p_ar, &new_again, &new_cycles);
+    }
+    else if (clear * 100 < (uint64_t)full_scale * p_ar->params.low_pct)
+    {
+        als_range_up(p_ar, &new_again, &new_cycles);
+
+        // Hysteresis, step up only when the new range would not be left
+        // again by the next sample
+        uint64_t predicted = (clear * new_cycles << (2 * new_again)) /
+            ((uint64_t)cycles << (2 * again));
+        if (predicted * 100 >=
+            (uint64_t)als_full_scale(new_cycles) * p_ar->params.high_pct)
+        {
+            new_again = again;
+            new_cycles = cycles;
+        }
+    }
+
+    if ((new_again != again) || (new_cycles != cycles))
+    {
+        b_is_all_ok = als_range_set(p_apds, new_again, new_cycles);
     }
 
     if (!b_is_all_ok)
     {
-        ERROR("Error reading ALS green light level.", __FUNCTION__);
+        ERROR("Error changing ALS range.", __FUNCTION__);
     }
 
     return b_is_all_ok;
 }
 
 bool
-apds9960_als_read_blue(apds9960_t *p_apds, uint16_t *value_blue)
+apds9960_als_wake_enable(apds9960_t *p_apds, uint8_t band_pct, uint8_t apers)
 {
     bool b_is_all_ok = false;
-    uint8_t reg_value;
 
-    *value_blue = 0;
+    if ((band_pct == 0) || (band_pct > 100) || (apers > ALS_WAKE_APERS_MAX))
+    {
+        ERROR("Invalid wake-on-change parameters.", __FUNCTION__);
+    }
+    else
+    {
+        p_apds->als_wake.band_pct = band_pct;
+        b_is_all_ok = true;
 
-    b_is_all_ok = reg_read8(p_apds, APDS9960_BDATAH, &reg_value);
-    if (b_is_all_ok)
+        apds9960_pers_t reg_pers;
+        reg_pers.byte = reg_shadow8(p_apds, APDS9960_PERS);
+        if (reg_pers.APERS != apers)
+        {
+            reg_pers.APERS = apers;
+            b_is_all_ok = reg_write8(p_apds, APDS9960_PERS, &reg_pers.byte);
+        }
+
+        // Empty window, first cycle interrupts and centres it
+        b_is_all_ok = b_is_all_ok && als_window_set(p_apds, 0xFFFF, 0) &&
+            apds9960_als_enable(p_apds, true);
+    }
+
+    p_apds->als_wake.b_is_enabled = b_is_all_ok;
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_als_wake_disable(apds9960_t *p_apds)
+{
+    p_apds->als_wake.b_is_enabled = false;
+}
+
+bool
+als_wake_update(apds9960_t *p_apds, const apds9960_sample_t *p_sample)
+{
+    uint16_t low = 0xFFFF;
+    uint16_t high = 0;
+    bool b_is_all_ok = true;
+
+    if (!p_apds->als_wake.b_is_enabled)
+    {
+        return true;
+    }
+
+    // Readings of another range than the next cycles leave window empty,
+    // next cycle interrupts again and centres it
+    if (p_sample->status.AVALID && !p_apds->als_autorange.b_is_settling)
     {
-        *value_blue = (uint16_t)(reg_value << 8);
-        b_is_all_ok = reg_read8(p_apds, APDS9960_BDATAL, &reg_value);
-        if (b_is_all_ok)
+        uint32_t clear = p_sample->rgbc.clear;
+        uint32_t delta = clear * p_apds->als_wake.band_pct / 100;
+
+        if (delta < ALS_WAKE_DELTA_MIN)
         {
-            *value_blue = (uint16_t)(*value_blue | reg_value);
+            delta = ALS_WAKE_DELTA_MIN;
         }
+
+        low = (uint16_t)((clear > delta) ? clear - delta : 0);
+        high = (uint16_t)((clear + delta > 0xFFFF) ? 0xFFFF : clear + delta);
     }
 
+    b_is_all_ok = als_window_set(p_apds, low, high);
+
     if (!b_is_all_ok)
     {
-        ERROR("Error reading ALS blue light level.", __FUNCTION__);
+        ERROR("Error setting ALS threshold window.", __FUNCTION__);
     }
 
     return b_is_all_ok;
 }
 
-
 /*******************************************************************************
 * Private function definitions
 *******************************************************************************/
 
+static bool
+als_sample_update(apds9960_t *p_apds)
+{
+    // CDATAL..BDATAH in one burst, the device latches all channels together
+    uint8_t buffer[APDS9960_BDATAH - APDS9960_CDATAL + 1];
+    bool b_is_all_ok = (reg_read(p_apds, APDS9960_CDATAL, buffer,
+        sizeof(buffer)) != -1);
+
+    if (b_is_all_ok)
+    {
+        p_apds->als_sample.clear = (uint16_t)(buffer[0] | (buffer[1] << 8));
+        p_apds->als_sample.red = (uint16_t)(buffer[2] | (buffer[3] << 8));
+        p_apds->als_sample.green = (uint16_t)(buffer[4] | (buffer[5] << 8));
+        p_apds->als_sample.blue = (uint16_t)(buffer[6] | (buffer[7] << 8));
+        p_apds->als_sample_fresh = ALS_CHANNELS_ALL;
+        clock_gettime(CLOCK_MONOTONIC, &p_apds->als_sample_time);
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+als_read_channel(apds9960_t *p_apds, uint8_t channel, uint16_t *p_value)
+{
+    bool b_is_all_ok = true;
+    struct timespec now;
+
+    *p_value = 0;
+
+    // Cached sample is replaced by the device after one integration period
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t period_ns = (int64_t)(256 - reg_shadow8(p_apds, APDS9960_ATIME)) *
+        APDS9960_ALS_CYCLE_US * 1000;
+
+    // Fetch new sample once this channel of the cached one has been used
+    if (!(p_apds->als_sample_fresh & (1 << channel)) ||
+        (timespec_diff_ns(&now, &p_apds->als_sample_time) >= period_ns))
+    {
+        b_is_all_ok = als_sample_update(p_apds);
+    }
+
+    if (b_is_all_ok)
+    {
+        switch (channel)
+        {
+        case ALS_CHANNEL_CLEAR:
+            *p_value = p_apds->als_sample.clear;
+            break;
+
+        case ALS_CHANNEL_RED:
+            *p_value = p_apds->als_sample.red;
+            break;
+
+        case ALS_CHANNEL_GREEN:
+            *p_value = p_apds->als_sample.green;
+            break;
+
+        default:
+            *p_value = p_apds->als_sample.blue;
+            break;
+        }
+
+        p_apds->als_sample_fresh &= (uint8_t)~(1 << channel);
+    }
+
+    return b_is_all_ok;
+}
+
+static void
+als_range_down(const apds9960_als_autorange_t *p_ar, uint8_t *p_again,
+    uint16_t *p_cycles)
+{
+    // Integration time beyond resolution goes first, then gain, then
+    // resolution is given up to avoid saturation
+    if (*p_cycles > p_ar->cycles_min)
+    {
+        *p_cycles = (*p_cycles / 2 > p_ar->cycles_min) ?
+            (uint16_t)(*p_cycles / 2) : p_ar->cycles_min;
+    }
+    else if (*p_again > CONTROL_AGAIN_1X)
+    {
+        (*p_again)--;
+    }
+    else if (*p_cycles > 1)
+    {
+        *p_cycles = (uint16_t)(*p_cycles / 2);
+    }
+}
+
+static void
+als_range_up(const apds9960_als_autorange_t *p_ar, uint8_t *p_again,
+    uint16_t *p_cycles)
+{
+    // Reverse order of als_range_down
+    if (*p_cycles < p_ar->cycles_min)
+    {
+        *p_cycles = (*p_cycles * 2 < p_ar->cycles_min) ?
+            (uint16_t)(*p_cycles * 2) : p_ar->cycles_min;
+    }
+    else if (*p_again < CONTROL_AGAIN_64X)
+    {
+        (*p_again)++;
+    }
+    else if (*p_cycles < p_ar->params.cycles_max)
+    {
+        *p_cycles = (*p_cycles * 2 < p_ar->params.cycles_max) ?
+            (uint16_t)(*p_cycles * 2) : p_ar->params.cycles_max;
+    }
+}
+
+static bool
+als_range_set(apds9960_t *p_apds, uint8_t again, uint16_t cycles)
+{
+    bool b_is_all_ok = true;
+    uint8_t reg_atime = (uint8_t)(256 - cycles);
+
+    apds9960_control_t reg_control;
+    reg_control.byte = reg_shadow8(p_apds, APDS9960_CONTROL);
+
+    // ATIME and CONTROL are not adjacent, write only the changed ones
+    if (reg_atime != reg_shadow8(p_apds, APDS9960_ATIME))
+    {
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ATIME, &reg_atime);
+        p_apds->als_autorange.b_is_settling = true;
+    }
+
+    if (b_is_all_ok && (reg_control.AGAIN != again))
+    {
+        reg_control.AGAIN = again;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_CONTROL, &reg_control.byte);
+        p_apds->als_autorange.b_is_settling = true;
+    }
+
+    return b_is_all_ok;
+}
+
+static uint32_t
+als_full_scale(uint16_t cycles)
+{
+    uint32_t counts = (uint32_t)cycles * APDS9960_ALS_CYCLE_COUNTS;
+
+    return (counts > 0xFFFF) ? 0xFFFF : counts;
+}
+
+static bool
+als_window_set(apds9960_t *p_apds, uint16_t low, uint16_t high)
+{
+    // AILTL..AIHTH are adjacent, whole window goes in one write
+    uint8_t window[APDS9960_AIHTH - APDS9960_AILTL + 1] = {
+        (uint8_t)(low & 0xFF), (uint8_t)(low >> 8),
+        (uint8_t)(high & 0xFF), (uint8_t)(high >> 8)
+    };
+
+    return reg_update(p_apds, APDS9960_AILTL, window, sizeof(window));
+}
 
 /* [] END OF FILE */
@@ -0,0 +1,423 @@
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_bus.h"
+
+#define BUS_MUX_UNKNOWN     0x100   // Channel mask of mux not known
+
+// Sensor behind its mux channel, transport context of the sensor
+typedef struct
+{
+    apds9960_bus_t *p_bus;
+    apds9960_t *p_apds;
+    int mux_index;                  // APDS9960_BUS_NO_MUX on upstream bus
+    uint8_t channel;
+    bool b_is_requested;
+} bus_port_t;
+
+typedef struct
+{
+    I2C_DeviceAddress addr;
+    uint16_t selected;              // Channel mask written last
+} bus_mux_t;
+
+struct apds9960_bus
+{
+    const apds9960_transport_t *p_transport;
+    void *p_transport_ctx;
+    int i2c_fd;
+    bus_mux_t muxes[APDS9960_BUS_MUX_MAX];
+    int mux_count;
+    bus_port_t ports[APDS9960_BUS_SENSORS_MAX];
+    int port_count;
+    apds9960_bus_stats_t stats;
+};
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Select channel of port, deselect channels of other muxes first.
+ *
+ * Muxes already in the wanted state are not written.
+ *
+ * @param p_port Port to select, NULL deselects all muxes.
+ *
+ * @return True on success.
+ */
+static bool
+bus_select(apds9960_bus_t *p_bus, const bus_port_t *p_port);
+
+static bool
+bus_mux_write(apds9960_bus_t *p_bus, int mux_index, uint16_t mask);
+
+/**
+ * @brief Run op for requested ports on channel of one mux.
+ *
+ * @return False when some op failed.
+ */
+static bool
+bus_run_channel(apds9960_bus_t *p_bus, int mux_index, uint8_t channel,
+    apds9960_bus_op_t op, void *p_ctx);
+
+static ssize_t
+bus_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len);
+
+static ssize_t
+bus_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len);
+
+static ssize_t
+bus_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len);
+
+static ssize_t
+bus_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const apds9960_transport_t TRANSPORT_BUS = {
+    .name = "bus",
+    .read = bus_read,
+    .write = bus_write,
+    .write_then_read = bus_write_then_read,
+    .transfer = bus_transfer
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_bus_t
+*apds9960_bus_open(const apds9960_transport_t *p_transport,
+    void *p_transport_ctx, int i2c_fd)
+{
+    apds9960_bus_t *p_bus = calloc(1, sizeof(apds9960_bus_t));
+
+    if (!p_bus)
+    {
+        ERROR("Not enough free memory.", __FUNCTION__);
+        return NULL;
+    }
+
+    p_bus->p_transport = p_transport ? p_transport : APDS9960_TRANSPORT_DEFAULT;
+    p_bus->p_transport_ctx = p_transport_ctx;
+    p_bus->i2c_fd = i2c_fd;
+
+    return p_bus;
+}
+
+void
+apds9960_bus_close(apds9960_bus_t *p_bus)
+{
+    if (!p_bus)
+    {
+        return;
+    }
+
+    for (int idx = 0; idx < p_bus->port_count; idx++)
+    {
+        apds9960_close(p_bus->ports[idx].p_apds);
+    }
+
+    bus_select(p_bus, NULL);
+
+    if (p_bus->i2c_fd >= 0)
+    {
+        close(p_bus->i2c_fd);
+    }
+
+    free(p_bus);
+}
+
+int
+apds9960_bus_add_mux(apds9960_bus_t *p_bus, I2C_DeviceAddress mux_addr)
+{
+    int mux_index = p_bus->mux_count;
+
+    if (mux_index >= APDS9960_BUS_MUX_MAX)
+    {
+        ERROR("Too many muxes.", __FUNCTION__);
+        return -1;
+    }
+
+    p_bus->muxes[mux_index].addr = mux_addr;
+    p_bus->muxes[mux_index].selected = BUS_MUX_UNKNOWN;
+    p_bus->mux_count++;
+
+    // Channels left selected by a previous user would shadow other muxes
+    if (!bus_mux_write(p_bus, mux_index, 0))
+    {
+        ERROR("Mux 0x%02X does not respond.", __FUNCTION__, mux_addr);
+        p_bus->mux_count--;
+        mux_index = -1;
+    }
+
+    return mux_index;
+}
+
+apds9960_t
+*apds9960_bus_open_sensor(apds9960_bus_t *p_bus, int mux_index,
+    uint8_t channel)
+{
+    bus_port_t *p_port = &p_bus->ports[p_bus->port_count];
+    bool b_is_all_ok = (p_bus->port_count < APDS9960_BUS_SENSORS_MAX) &&
+        (mux_index >= APDS9960_BUS_NO_MUX) && (mux_index < p_bus->mux_count) &&
+        (channel < APDS9960_BUS_CHANNELS);
+
+    if (mux_index == APDS9960_BUS_NO_MUX)
+    {
+        channel = 0;
+    }
+
+    // Sensors share the address, one per channel
+    for (int idx = 0; b_is_all_ok && (idx < p_bus->port_count); idx++)
+    {
+        b_is_all_ok = (p_bus->ports[idx].mux_index != mux_index) ||
+            (p_bus->ports[idx].channel != channel);
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Invalid or used mux channel.", __FUNCTION__);
+        return NULL;
+    }
+
+    memset(p_port, 0, sizeof(bus_port_t));
+    p_port->p_bus = p_bus;
+    p_port->mux_index = mux_index;
+    p_port->channel = channel;
+    p_port->p_apds = apds9960_open_transport(&TRANSPORT_BUS, p_port,
+        p_bus->i2c_fd, APDS9960_I2C_ADDRESS);
+
+    if (p_port->p_apds)
+    {
+        p_bus->port_count++;
+    }
+
+    return p_port->p_apds;
+}
+
+void
+apds9960_bus_request(apds9960_bus_t *p_bus, apds9960_t *p_apds)
+{
+    for (int idx = 0; idx < p_bus->port_count; idx++)
+    {
+        if (!p_apds || (p_bus->ports[idx].p_apds == p_apds))
+        {
+            p_bus->ports[idx].b_is_requested = true;
+        }
+    }
+}
+
+bool
+apds9960_bus_run(apds9960_bus_t *p_bus, apds9960_bus_op_t op, void *p_ctx)
+{
+    bool b_is_all_ok = true;
+    int first_mux = 0;
+    uint8_t first_channel = 0;
+
+    // Start at the channel selected now, it costs no mux write
+    for (int mux_index = 0; mux_index < p_bus->mux_count; mux_index++)
+    {
+        uint16_t selected = p_bus->muxes[mux_index].selected;
+
+        for (uint8_t channel = 0; channel < APDS9960_BUS_CHANNELS; channel++)
+        {
+            if (selected == (1u << channel))
+            {
+                first_mux = mux_index;
+                first_channel = channel;
+            }
+        }
+    }
+
+    if ((p_bus->mux_count == 0) ||
+        (p_bus->muxes[first_mux].selected != (1u << first_channel)))
+    {
+        // Nothing selected, upstream sensors need no mux write
+        b_is_all_ok = bus_run_channel(p_bus, APDS9960_BUS_NO_MUX, 0, op, p_ctx);
+    }
+
+    // Channels of one mux in a row, switching among them is a single write
+    for (int mux_count = 0; mux_count < p_bus->mux_count; mux_count++)
+    {
+        int mux_index = (first_mux + mux_count) % p_bus->mux_count;
+
+        for (uint8_t ch_count = 0; ch_count < APDS9960_BUS_CHANNELS; ch_count++)
+        {
+            uint8_t channel = (uint8_t)((first_channel + ch_count) %
+                APDS9960_BUS_CHANNELS);
+
+            b_is_all_ok = bus_run_channel(p_bus, mux_index, channel, op,
+                p_ctx) && b_is_all_ok;
+        }
+    }
+
+    // Upstream sensors left when a mux channel was selected
+    b_is_all_ok = bus_run_channel(p_bus, APDS9960_BUS_NO_MUX, 0, op, p_ctx) &&
+        b_is_all_ok;
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_bus_get_stats(const apds9960_bus_t *p_bus,
+    apds9960_bus_stats_t *p_stats)
+{
+    *p_stats = p_bus->stats;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+bus_select(apds9960_bus_t *p_bus, const bus_port_t *p_port)
+{
+    bool b_is_all_ok = true;
+    int target = p_port ? p_port->mux_index : APDS9960_BUS_NO_MUX;
+
+    // Never two sensors on the bus at once, deselect before selecting
+    for (int idx = 0; b_is_all_ok && (idx < p_bus->mux_count); idx++)
+    {
+        if ((idx != target) && (p_bus->muxes[idx].selected != 0))
+        {
+            b_is_all_ok = bus_mux_write(p_bus, idx, 0);
+        }
+    }
+
+    if (b_is_all_ok && (target != APDS9960_BUS_NO_MUX) &&
+        (p_bus->muxes[target].selected != (1u << p_port->channel)))
+    {
+        b_is_all_ok = bus_mux_write(p_bus, target,
+            (uint16_t)(1u << p_port->channel));
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+bus_mux_write(apds9960_bus_t *p_bus, int mux_index, uint16_t mask)
+{
+    bus_mux_t *p_mux = &p_bus->muxes[mux_index];
+    uint8_t control = (uint8_t)mask;
+
+    p_bus->stats.mux_writes++;
+
+    // TCA9548A takes the channel mask as its only register
+    bool b_is_all_ok = (p_bus->p_transport->write(p_bus->p_transport_ctx,
+        p_bus->i2c_fd, p_mux->addr, &control, 1) != -1);
+
+    p_mux->selected = b_is_all_ok ? mask : BUS_MUX_UNKNOWN;
+
+    return b_is_all_ok;
+}
+
+static bool
+bus_run_channel(apds9960_bus_t *p_bus, int mux_index, uint8_t channel,
+    apds9960_bus_op_t op, void *p_ctx)
+{
+    bool b_is_all_ok = true;
+
+    for (int idx = 0; idx < p_bus->port_count; idx++)
+    {
+        bus_port_t *p_port = &p_bus->ports[idx];
+
+        if (p_port->b_is_requested && (p_port->mux_index == mux_index) &&
+            (p_port->channel == channel))
+        {
+            p_port->b_is_requested = false;
+            b_is_all_ok = op(p_port->p_apds, p_ctx) && b_is_all_ok;
+        }
+    }
+
+    return b_is_all_ok;
+}
+
+static ssize_t
+bus_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len)
+{
+    bus_port_t *p_port = (bus_port_t *)p_ctx;
+    apds9960_bus_t *p_bus = p_port->p_bus;
+
+    if (!bus_select(p_bus, p_port))
+    {
+        return -1;
+    }
+
+    p_bus->stats.transactions++;
+
+    return p_bus->p_transport->read(p_bus->p_transport_ctx, i2c_fd, i2c_addr,
+        p_data, data_len);
+}
+
+static ssize_t
+bus_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len)
+{
+    bus_port_t *p_port = (bus_port_t *)p_ctx;
+    apds9960_bus_t *p_bus = p_port->p_bus;
+
+    if (!bus_select(p_bus, p_port))
+    {
+        return -1;
+    }
+
+    p_bus->stats.transactions++;
+
+    return p_bus->p_transport->write(p_bus->p_transport_ctx, i2c_fd, i2c_addr,
+        p_data, data_len);
+}
+
+static ssize_t
+bus_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len)
+{
+    bus_port_t *p_port = (bus_port_t *)p_ctx;
+    apds9960_bus_t *p_bus = p_port->p_bus;
+
+    if (!bus_select(p_bus, p_port))
+    {
+        return -1;
+    }
+
+    p_bus->stats.transactions++;
+
+    return p_bus->p_transport->write_then_read(p_bus->p_transport_ctx, i2c_fd,
+        i2c_addr, p_wr_data, wr_len, p_rd_data, rd_len);
+}
+
+static ssize_t
+bus_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count)
+{
+    bus_port_t *p_port = (bus_port_t *)p_ctx;
+    apds9960_bus_t *p_bus = p_port->p_bus;
+
+    if (!bus_select(p_bus, p_port))
+    {
+        return -1;
+    }
+
+    p_bus->stats.transactions++;
+
+    return p_bus->p_transport->transfer(p_bus->p_transport_ctx, i2c_fd,
+        i2c_addr, p_msgs, msg_count);
+}
+
+/* [] END OF FILE */
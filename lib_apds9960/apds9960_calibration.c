@@ -0,0 +1,379 @@
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+#define CALIB_RESIDUAL_TARGET   2   // Counts left above zero, avoids clipping
+#define CALIB_RESIDUAL_MAX      8   // Largest residual passing verification
+#define CALIB_OFFSET_MAX_BIT    0x40    // Offsets are sign-magnitude, 0..127
+#define CALIB_CYCLES_MAX        32  // Gesture FIFO depth
+#define CALIB_WAIT_MS           2   // PVALID poll period
+#define CALIB_TIMEOUT_MS        500 // Maximum wait for proximity cycle
+
+// PMASK_x bits of CONFIG3
+#define CALIB_PMASK_UR          0x09
+#define CALIB_PMASK_DL          0x06
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Find proximity offset leaving CALIB_RESIDUAL_TARGET counts.
+ *
+ * Photodiodes sharing the offset register are measured alone by masking
+ * the other pair. Offset bits are set from the highest one down as long
+ * as the reading stays at or above target.
+ *
+ * @param p_apds Device.
+ * @param offset_reg POFFSET_UR or POFFSET_DL.
+ * @param pmask CONFIG3 PMASK bits of the other photodiode pair.
+ * @param cycles Proximity cycles averaged per measurement.
+ * @param p_residual Reading with the chosen offset.
+ *
+ * @return true on success.
+ */
+static bool
+calib_prox_search(apds9960_t *p_apds, uint8_t offset_reg, uint8_t pmask,
+    uint8_t cycles, uint8_t *p_residual);
+
+static bool
+calib_prox_measure(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_mean);
+
+static bool
+calib_prox_wait(apds9960_t *p_apds, uint8_t *p_pdata);
+
+/**
+ * @brief Find U/D/L/R gesture offsets, all four searched in parallel.
+ *
+ * @param p_apds Device with gesture engine forced on.
+ * @param cycles Gesture datasets averaged per measurement.
+ * @param p_residuals Readings with the chosen offsets, U/D/L/R.
+ *
+ * @return true on success.
+ */
+static bool
+calib_gesture_search(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_residuals);
+
+static bool
+calib_gesture_measure(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_means);
+
+static bool
+calib_goffset_write(apds9960_t *p_apds, const uint8_t *p_goffsets);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+bool
+apds9960_offsets_calibrate(apds9960_t *p_apds, uint8_t cycles,
+    apds9960_offsets_t *p_offsets)
+{
+    uint8_t saved_enable = reg_shadow8(p_apds, APDS9960_ENABLE);
+    uint8_t saved_config3 = reg_shadow8(p_apds, APDS9960_CONFIG3);
+    uint8_t saved_gexth = reg_shadow8(p_apds, APDS9960_GEXTH);
+    uint8_t saved_gconf4 = reg_shadow8(p_apds, APDS9960_GCONF4);
+    uint8_t residuals[6] = { 0 };
+    uint8_t gexth = 0;
+    bool b_is_verified = true;
+    bool b_is_all_ok;
+
+    apds9960_enable_t reg_enable;
+    apds9960_gconf4_t reg_gconf4;
+
+    if ((cycles == 0) || (cycles > CALIB_CYCLES_MAX))
+    {
+        ERROR("Invalid calibration cycle count.", __FUNCTION__);
+        return false;
+    }
+
+    // Proximity engine alone, no interrupts during calibration
+    reg_enable.byte = 0;
+    reg_enable.PON = 1;
+    reg_enable.PEN = 1;
+    b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
+
+    b_is_all_ok = b_is_all_ok &&
+        calib_prox_search(p_apds, APDS9960_POFFSET_UR, CALIB_PMASK_DL, cycles,
+            &residuals[0]) &&
+        calib_prox_search(p_apds, APDS9960_POFFSET_DL, CALIB_PMASK_UR, cycles,
+            &residuals[1]);
+
+    // Force gesture engine on, zero exit threshold keeps it running
+    // without a target
+    if (b_is_all_ok)
+    {
+        b_is_all_ok = reg_write8(p_apds, APDS9960_CONFIG3, &saved_config3) &&
+            reg_write8(p_apds, APDS9960_GEXTH, &gexth);
+    }
+
+    if (b_is_all_ok)
+    {
+        reg_enable.GEN = 1;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
+    }
+
+    if (b_is_all_ok)
+    {
+        reg_gconf4.byte = saved_gconf4;
+        reg_gconf4.GMODE = 1;
+        reg_gconf4.GIEN = 0;
+        reg_gconf4.GFIFO_CLR = 1;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte) &&
+            calib_gesture_search(p_apds, cycles, &residuals[2]);
+    }
+
+    // Restore configuration, discard calibration datasets
+    reg_gconf4.byte = saved_gconf4;
+    reg_gconf4.GFIFO_CLR = 1;
+    if (!reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte) ||
+        !reg_write8(p_apds, APDS9960_GEXTH, &saved_gexth) ||
+        !reg_write8(p_apds, APDS9960_CONFIG3, &saved_config3) ||
+        !reg_write8(p_apds, APDS9960_ENABLE, &saved_enable))
+    {
+        b_is_all_ok = false;
+    }
+
+    if (b_is_all_ok)
+    {
+        // Offset range could not cancel crosstalk of some photodiode
+        for (int idx = 0; idx < 6; idx++)
+        {
+            DEBUG_DEV("Calibration residual %d: %d", __FUNCTION__, p_apds,
+                idx, residuals[idx]);
+
+            if (residuals[idx] > CALIB_RESIDUAL_MAX)
+            {
+                b_is_verified = false;
+            }
+        }
+
+        apds9960_offsets_get(p_apds, p_offsets);
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error calibrating offsets.", __FUNCTION__);
+    }
+    else if (!b_is_verified)
+    {
+        ERROR("Offset calibration left residual crosstalk.", __FUNCTION__);
+    }
+
+    return b_is_all_ok && b_is_verified;
+}
+
+bool
+apds9960_offsets_apply(apds9960_t *p_apds, const apds9960_offsets_t *p_offsets)
+{
+    // POFFSET_UR and POFFSET_DL are adjacent
+    uint8_t poffsets[2] = { p_offsets->poffset_ur, p_offsets->poffset_dl };
+    uint8_t goffsets[4] = {
+        p_offsets->goffset_u, p_offsets->goffset_d,
+        p_offsets->goffset_l, p_offsets->goffset_r
+    };
+
+    bool b_is_all_ok = reg_update(p_apds, APDS9960_POFFSET_UR, poffsets,
+        sizeof(poffsets)) && calib_goffset_write(p_apds, goffsets);
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error applying offsets.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_offsets_get(const apds9960_t *p_apds, apds9960_offsets_t *p_offsets)
+{
+    p_offsets->poffset_ur = reg_shadow8(p_apds, APDS9960_POFFSET_UR);
+    p_offsets->poffset_dl = reg_shadow8(p_apds, APDS9960_POFFSET_DL);
+    p_offsets->goffset_u = reg_shadow8(p_apds, APDS9960_GOFFSET_U);
+    p_offsets->goffset_d = reg_shadow8(p_apds, APDS9960_GOFFSET_D);
+    p_offsets->goffset_l = reg_shadow8(p_apds, APDS9960_GOFFSET_L);
+    p_offsets->goffset_r = reg_shadow8(p_apds, APDS9960_GOFFSET_R);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+calib_prox_search(apds9960_t *p_apds, uint8_t offset_reg, uint8_t pmask,
+    uint8_t cycles, uint8_t *p_residual)
+{
+    uint8_t offset = 0;
+    uint8_t trial;
+    uint8_t mean = 0;
+
+    // Masking one photodiode of U-D and L-R pairs needs gain compensation
+    apds9960_config3_t reg_config3;
+    reg_config3.byte = reg_shadow8(p_apds, APDS9960_CONFIG3);
+    reg_config3.byte = (uint8_t)((reg_config3.byte & 0xF0) | pmask);
+    reg_config3.PCMP = 1;
+
+    bool b_is_all_ok = reg_write8(p_apds, APDS9960_CONFIG3, &reg_config3.byte);
+
+    for (uint8_t bit = CALIB_OFFSET_MAX_BIT; b_is_all_ok && bit; bit >>= 1)
+    {
+        trial = offset | bit;
+        b_is_all_ok = reg_write8(p_apds, offset_reg, &trial) &&
+            calib_prox_measure(p_apds, cycles, &mean);
+
+        if (b_is_all_ok && (mean >= CALIB_RESIDUAL_TARGET))
+        {
+            offset = trial;
+        }
+    }
+
+    // Verify chosen offset
+    b_is_all_ok = b_is_all_ok && reg_write8(p_apds, offset_reg, &offset) &&
+        calib_prox_measure(p_apds, cycles, p_residual);
+
+    return b_is_all_ok;
+}
+
+static bool
+calib_prox_measure(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_mean)
+{
+    uint32_t sum = 0;
+    uint8_t pdata = 0;
+
+    // First cycle may have run while offset changed
+    bool b_is_all_ok = calib_prox_wait(p_apds, &pdata);
+
+    for (uint8_t idx = 0; b_is_all_ok && (idx < cycles); idx++)
+    {
+        b_is_all_ok = calib_prox_wait(p_apds, &pdata);
+        sum += pdata;
+    }
+
+    *p_mean = (uint8_t)((sum + cycles / 2) / cycles);
+
+    return b_is_all_ok;
+}
+
+static bool
+calib_prox_wait(apds9960_t *p_apds, uint8_t *p_pdata)
+{
+    const struct timespec POLL_DELAY = { 0, CALIB_WAIT_MS * 1000000 };
+
+    apds9960_status_t reg_status;
+    bool b_is_all_ok = true;
+    int waited_ms = 0;
+
+    reg_status.byte = 0;
+
+    // Reading PDATA clears PVALID, next one is set by a new cycle
+    while (b_is_all_ok && !reg_status.PVALID)
+    {
+        b_is_all_ok = reg_read8(p_apds, APDS9960_STATUS, &reg_status.byte);
+
+        if (b_is_all_ok && !reg_status.PVALID)
+        {
+            if (waited_ms >= CALIB_TIMEOUT_MS)
+            {
+                b_is_all_ok = false;
+                break;
+            }
+
+            nanosleep(&POLL_DELAY, NULL);
+            waited_ms += CALIB_WAIT_MS;
+        }
+    }
+
+    return b_is_all_ok && reg_read8(p_apds, APDS9960_PDATA, p_pdata);
+}
+
+static bool
+calib_gesture_search(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_residuals)
+{
+    uint8_t offsets[4] = { 0 };
+    uint8_t trials[4];
+    uint8_t means[4];
+    bool b_is_all_ok = true;
+
+    // Photodiodes have separate offsets, one measurement serves all four
+    for (uint8_t bit = CALIB_OFFSET_MAX_BIT; b_is_all_ok && bit; bit >>= 1)
+    {
+        for (int diode = 0; diode < 4; diode++)
+        {
+            trials[diode] = offsets[diode] | bit;
+        }
+
+        b_is_all_ok = calib_goffset_write(p_apds, trials) &&
+            calib_gesture_measure(p_apds, cycles, means);
+
+        for (int diode = 0; b_is_all_ok && (diode < 4); diode++)
+        {
+            if (means[diode] >= CALIB_RESIDUAL_TARGET)
+            {
+                offsets[diode] = trials[diode];
+            }
+        }
+    }
+
+    // Verify chosen offsets
+    b_is_all_ok = b_is_all_ok && calib_goffset_write(p_apds, offsets) &&
+        calib_gesture_measure(p_apds, cycles, p_residuals);
+
+    return b_is_all_ok;
+}
+
+static bool
+calib_gesture_measure(apds9960_t *p_apds, uint8_t cycles, uint8_t *p_means)
+{
+    uint8_t buffer[CALIB_CYCLES_MAX * 4];
+    uint32_t sums[4] = { 0 };
+    bool b_is_filled = false;
+
+    // Datasets collected so far were taken with previous offsets, clear
+    // them. Shadow never holds GFIFO_CLR, it has to be set on every write.
+    apds9960_gconf4_t reg_gconf4;
+    reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+    reg_gconf4.GFIFO_CLR = 1;
+
+    bool b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte) &&
+        gesture_fifo_wait_level(p_apds, cycles, &b_is_filled) && b_is_filled &&
+        gesture_fifo_read(p_apds, buffer, (uint32_t)cycles * 4,
+            p_apds->gesture_fifo_chunk);
+
+    for (uint8_t idx = 0; b_is_all_ok && (idx < cycles); idx++)
+    {
+        for (int diode = 0; diode < 4; diode++)
+        {
+            sums[diode] += buffer[idx * 4 + diode];
+        }
+    }
+
+    for (int diode = 0; diode < 4; diode++)
+    {
+        p_means[diode] = (uint8_t)((sums[diode] + cycles / 2) / cycles);
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+calib_goffset_write(apds9960_t *p_apds, const uint8_t *p_goffsets)
+{
+    // GOFFSET_U, GOFFSET_D, GPULSE, GOFFSET_L are adjacent, GPULSE is
+    // rewritten unchanged to save a transaction
+    uint8_t block[APDS9960_GOFFSET_L - APDS9960_GOFFSET_U + 1] = {
+        p_goffsets[0], p_goffsets[1],
+        reg_shadow8(p_apds, APDS9960_GPULSE), p_goffsets[2]
+    };
+
+    return reg_update(p_apds, APDS9960_GOFFSET_U, block, sizeof(block)) &&
+        reg_update(p_apds, APDS9960_GOFFSET_R, &p_goffsets[3], 1);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,302 @@
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_capture.h"
+
+static const uint8_t CAPTURE_MAGIC[4] = { 'A', 'G', 'C', 'P' };
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+capture_record(apds9960_capture_t *p_cap, const struct timespec *p_now,
+    uint8_t type, uint8_t arg0, uint8_t arg1, const uint8_t *p_payload,
+    uint8_t payload_len);
+
+static bool
+capture_write(apds9960_capture_t *p_cap, const uint8_t *p_data,
+    size_t data_len);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_capture_t
+*apds9960_capture_open(int fd)
+{
+    uint8_t header[APDS9960_CAPTURE_HEADER_SIZE] = { 0 };
+    apds9960_capture_t *p_cap = calloc(1, sizeof(apds9960_capture_t));
+
+    if (p_cap)
+    {
+        p_cap->fd = fd;
+
+        memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        header[4] = APDS9960_CAPTURE_VERSION;
+        memcpy(p_cap->buffer, header, sizeof(header));
+        p_cap->buffer_len = sizeof(header);
+    }
+    else
+    {
+        ERROR("Not enough free memory.", __FUNCTION__);
+    }
+
+    return p_cap;
+}
+
+bool
+apds9960_capture_close(apds9960_capture_t *p_cap)
+{
+    bool b_is_all_ok = apds9960_capture_flush(p_cap);
+
+    free(p_cap);
+
+    return b_is_all_ok;
+}
+
+bool
+apds9960_capture_flush(apds9960_capture_t *p_cap)
+{
+    size_t done = 0;
+
+    while (!p_cap->b_is_error && (done < p_cap->buffer_len))
+    {
+        ssize_t result = write(p_cap->fd, &p_cap->buffer[done],
+            p_cap->buffer_len - done);
+
+        if (result <= 0)
+        {
+            ERROR("Capture write failed, recording stopped.", __FUNCTION__);
+            p_cap->b_is_error = true;
+        }
+        else
+        {
+            done += (size_t)result;
+        }
+    }
+
+    p_cap->buffer_len = 0;
+
+    return !p_cap->b_is_error;
+}
+
+bool
+apds9960_capture_config(apds9960_capture_t *p_cap, const apds9960_t *p_apds)
+{
+    apds9960_capture_config_t config;
+
+    config.gpenth = reg_shadow8(p_apds, APDS9960_GPENTH);
+    config.gexth = reg_shadow8(p_apds, APDS9960_GEXTH);
+    config.gconf1 = reg_shadow8(p_apds, APDS9960_GCONF1);
+    config.gconf2 = reg_shadow8(p_apds, APDS9960_GCONF2);
+    config.gpulse = reg_shadow8(p_apds, APDS9960_GPULSE);
+    config.gconf3 = reg_shadow8(p_apds, APDS9960_GCONF3);
+    config.gconf4 = reg_shadow8(p_apds, APDS9960_GCONF4);
+    config.config2 = reg_shadow8(p_apds, APDS9960_CONFIG2);
+
+    return capture_record(p_cap, NULL, CAPTURE_REC_CONFIG, 0, 0,
+        (const uint8_t *)&config, sizeof(config));
+}
+
+bool
+apds9960_capture_label(apds9960_capture_t *p_cap, int gesture)
+{
+    return capture_record(p_cap, NULL, CAPTURE_REC_LABEL, (uint8_t)gesture,
+        0, NULL, 0);
+}
+
+void
+apds9960_capture_hook(void *p_ctx, const struct timespec *p_now,
+    apds9960_gstatus_t gstatus, uint8_t dataset_count,
+    const uint8_t *p_datasets)
+{
+    apds9960_capture_t *p_cap = (apds9960_capture_t *)p_ctx;
+
+    // Idle polls are skipped, only data and GVALID changes end up in capture
+    if ((dataset_count > 0) || (gstatus.GVALID != p_cap->b_is_valid_recorded))
+    {
+        if (capture_record(p_cap, p_now, CAPTURE_REC_BATCH, dataset_count,
+            gstatus.byte, p_datasets, (uint8_t)(dataset_count * 4)))
+        {
+            p_cap->b_is_valid_recorded = gstatus.GVALID;
+        }
+    }
+}
+
+int
+apds9960_capture_replay(const uint8_t *p_data, size_t data_len,
+    apds9960_gesture_decoder_t *p_dec, apds9960_replay_cb_t p_callback,
+    void *p_ctx, apds9960_capture_config_t *p_config)
+{
+    apds9960_replay_gesture_t decoded;
+    apds9960_gstatus_t gstatus;
+    uint64_t time_us = 0;
+    int label = GESTURE_DIR_NONE;
+    int count = 0;
+    size_t pos = APDS9960_CAPTURE_HEADER_SIZE;
+
+    if ((data_len < APDS9960_CAPTURE_HEADER_SIZE) ||
+        (memcmp(p_data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) ||
+        (p_data[4] != APDS9960_CAPTURE_VERSION))
+    {
+        ERROR("Not a gesture capture.", __FUNCTION__);
+        return -1;
+    }
+
+    apds9960_gesture_decoder_reset(p_dec);
+
+    while (pos + APDS9960_CAPTURE_RECORD_SIZE <= data_len)
+    {
+        const uint8_t *p_record = &p_data[pos];
+        const uint8_t *p_payload = p_record + APDS9960_CAPTURE_RECORD_SIZE;
+        uint8_t payload_len = p_record[1];
+
+        if (pos + APDS9960_CAPTURE_RECORD_SIZE + payload_len > data_len)
+        {
+            break;
+        }
+
+        time_us += (uint32_t)p_record[4] | ((uint32_t)p_record[5] << 8) |
+            ((uint32_t)p_record[6] << 16) | ((uint32_t)p_record[7] << 24);
+
+        switch (p_record[0])
+        {
+            case CAPTURE_REC_BATCH:
+                if (payload_len != p_record[2] * 4)
+                {
+                    ERROR("Malformed batch at offset %zu.", __FUNCTION__, pos);
+                    return -1;
+                }
+
+                gstatus.byte = p_record[3];
+                decoded.gesture = apds9960_gesture_decoder_feed(p_dec,
+                    gstatus.GVALID, p_payload, p_record[2],
+                    &decoded.dset_count);
+
+                if (decoded.gesture != GESTURE_DIR_NONE)
+                {
+                    decoded.time_us = time_us;
+                    decoded.label = label;
+                    count++;
+
+                    if (p_callback)
+                    {
+                        p_callback(p_ctx, &decoded);
+                    }
+                }
+                break;
+
+            case CAPTURE_REC_CONFIG:
+                if (p_config && (payload_len == sizeof(*p_config)))
+                {
+                    memcpy(p_config, p_payload, sizeof(*p_config));
+                }
+                break;
+
+            case CAPTURE_REC_LABEL:
+                label = p_record[2];
+                break;
+
+            default:
+                // Unknown records are skipped for forward compatibility
+                break;
+        }
+
+        pos += APDS9960_CAPTURE_RECORD_SIZE + payload_len;
+    }
+
+    if (pos != data_len)
+    {
+        ERROR("Capture truncated at offset %zu.", __FUNCTION__, pos);
+    }
+
+    return count;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+capture_record(apds9960_capture_t *p_cap, const struct timespec *p_now,
+    uint8_t type, uint8_t arg0, uint8_t arg1, const uint8_t *p_payload,
+    uint8_t payload_len)
+{
+    uint8_t header[APDS9960_CAPTURE_RECORD_SIZE];
+    int64_t delta_us = 0;
+    uint32_t dt_us;
+    bool b_is_all_ok = false;
+
+    // Records without time are stamped with time of previous record
+    if (p_now && timespec_is_zero(&p_cap->last_record))
+    {
+        // Capture time starts with first timed record
+        p_cap->last_record = *p_now;
+    }
+    else if (p_now)
+    {
+        delta_us = timespec_diff_ns(p_now, &p_cap->last_record) / 1000;
+    }
+
+    if (!p_cap->b_is_error)
+    {
+        // Time goes forward only, long pauses saturate
+        dt_us = (delta_us < 0) ? 0 :
+            ((delta_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)delta_us);
+
+        // Advance by recorded delta so rounding errors do not accumulate
+        p_cap->last_record.tv_sec += dt_us / 1000000;
+        p_cap->last_record.tv_nsec += (long)(dt_us % 1000000) * 1000;
+        if (p_cap->last_record.tv_nsec >= 1000000000L)
+        {
+            p_cap->last_record.tv_nsec -= 1000000000L;
+            p_cap->last_record.tv_sec++;
+        }
+
+        header[0] = type;
+        header[1] = payload_len;
+        header[2] = arg0;
+        header[3] = arg1;
+        header[4] = (uint8_t)(dt_us & 0xFF);
+        header[5] = (uint8_t)((dt_us >> 8) & 0xFF);
+        header[6] = (uint8_t)((dt_us >> 16) & 0xFF);
+        header[7] = (uint8_t)(dt_us >> 24);
+
+        b_is_all_ok = capture_write(p_cap, header, sizeof(header)) &&
+            capture_write(p_cap, p_payload, payload_len);
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+capture_write(apds9960_capture_t *p_cap, const uint8_t *p_data,
+    size_t data_len)
+{
+    bool b_is_all_ok = true;
+
+    if (p_cap->buffer_len + data_len > sizeof(p_cap->buffer))
+    {
+        b_is_all_ok = apds9960_capture_flush(p_cap);
+    }
+
+    if (b_is_all_ok && (data_len > 0))
+    {
+        memcpy(&p_cap->buffer[p_cap->buffer_len], p_data, data_len);
+        p_cap->buffer_len += data_len;
+    }
+
+    return b_is_all_ok;
+}
+
+/* [] END OF FILE */
@@ -1,9 +1,14 @@
 #include <stdbool.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <string.h>
 
+#ifdef APDS9960_LINUX_HOST
+#include <stdio.h>
+#else
 #include <applibs/log.h>
 #include <applibs/i2c.h>
+#endif
 
 #include "lib_apds9960.h"
 #include "apds9960_common.h"
@@ -12,6 +17,10 @@
 * Forward declarations of private functions
 *******************************************************************************/
 
+static void
+shadow_update(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
+    uint32_t data_len);
+
 /*******************************************************************************
 * Global variables
 *******************************************************************************/
@@ -26,7 +35,11 @@ log_printf(const char *p_format, ...)
     va_list args;
 
     va_start(args, p_format);
+#   ifdef APDS9960_LINUX_HOST
+    int result = vfprintf(stderr, p_format, args);
+#   else
     int result = Log_DebugVarArgs(p_format, args);
+#   endif
     va_end(args);
 
     return result;
@@ -72,8 +85,8 @@ reg_read(apds9960_t *p_apds, uint8_t reg_addr, uint8_t *p_data,
 #       endif
 
         // Select register and read its data
-        result = I2CMaster_WriteThenRead(p_apds->i2c_fd, p_apds->i2c_addr,
-            &reg_addr, 1, p_data, data_len);
+        result = p_apds->p_transport->write_then_read(p_apds->p_transport_ctx,
+            p_apds->i2c_fd, p_apds->i2c_addr, &reg_addr, 1, p_data, data_len);
 
         if (result == -1)
         {
@@ -92,11 +105,13 @@ reg_read(apds9960_t *p_apds, uint8_t reg_addr, uint8_t *p_data,
             }
             log_printf("\n");
 #           endif
+
+            // Return length of read data only
+            result--;
         }
     }
-    
-    // Return length of read data only
-    return result - 1;
+
+    return result;
 }
 
 ssize_t
@@ -129,8 +144,8 @@ reg_write(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
 #		endif
 
         // Select register and write data
-        result = I2CMaster_Write(p_apds->i2c_fd, p_apds->i2c_addr, buffer, 
-            data_len + 1);
+        result = p_apds->p_transport->write(p_apds->p_transport_ctx,
+            p_apds->i2c_fd, p_apds->i2c_addr, buffer, data_len + 1);
 
         if (result == -1)
         {
@@ -140,13 +155,129 @@ reg_write(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
                 p_apds->i2c_addr);
 #           endif
         }
+        else
+        {
+            shadow_update(p_apds, reg_addr, p_data, data_len);
+        }
     }
 
     return result;
 }
 
+bool
+reg_write_addr(apds9960_t *p_apds, uint8_t reg_addr)
+{
+    bool b_result = false;
+    uint8_t no_data = 0;
+
+    if (reg_write(p_apds, reg_addr, &no_data, 0) != -1)
+    {
+        b_result = true;
+    }
+
+    return b_result;
+}
+
+bool
+reg_update(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
+    uint32_t data_len)
+{
+    bool b_is_all_ok = true;
+
+    for (uint32_t idx = 0; idx < data_len; idx++)
+    {
+        if (p_data[idx] != reg_shadow8(p_apds, (uint8_t)(reg_addr + idx)))
+        {
+            b_is_all_ok = (reg_write(p_apds, reg_addr, p_data, data_len) != -1);
+            break;
+        }
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+reg_is_shadowed(uint8_t reg_addr)
+{
+    return REG_IS_SHADOWED(reg_addr);
+}
+
+uint8_t
+reg_shadow8(const apds9960_t *p_apds, uint8_t reg_addr)
+{
+    uint8_t value = 0;
+
+    if (reg_is_shadowed(reg_addr))
+    {
+        value = p_apds->reg_shadow[reg_addr - APDS9960_SHADOW_FIRST];
+    }
+
+    return value;
+}
+
+void
+timespec_add_ms(struct timespec *p_ts, uint32_t ms)
+{
+    p_ts->tv_sec += ms / 1000;
+    p_ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (p_ts->tv_nsec >= 1000000000)
+    {
+        p_ts->tv_sec++;
+        p_ts->tv_nsec -= 1000000000;
+    }
+}
+
+void
+timespec_add_us(struct timespec *p_ts, uint32_t us)
+{
+    p_ts->tv_sec += us / 1000000;
+    p_ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (p_ts->tv_nsec >= 1000000000)
+    {
+        p_ts->tv_sec++;
+        p_ts->tv_nsec -= 1000000000;
+    }
+}
+
+bool
+timespec_is_zero(const struct timespec *p_ts)
+{
+    return (p_ts->tv_sec == 0) && (p_ts->tv_nsec == 0);
+}
+
+int64_t
+timespec_diff_ns(const struct timespec *p_end, const struct timespec *p_start)
+{
+    return ((int64_t)(p_end->tv_sec - p_start->tv_sec) * 1000000000) +
+        (p_end->tv_nsec - p_start->tv_nsec);
+}
+
 /*******************************************************************************
 * Private function definitions
 *******************************************************************************/
 
+static void
+shadow_update(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
+    uint32_t data_len)
+{
+    for (uint32_t i = 0; i < data_len; i++)
+    {
+        uint32_t addr = reg_addr + i;
+
+        if ((addr <= APDS9960_SHADOW_LAST) && reg_is_shadowed((uint8_t)addr))
+        {
+            p_apds->reg_shadow[addr - APDS9960_SHADOW_FIRST] = p_data[i];
+        }
+    }
+
+    // GFIFO_CLR is self-clearing, do not keep it in the shadow
+    if ((reg_addr <= APDS9960_GCONF4) && (reg_addr + data_len > APDS9960_GCONF4))
+    {
+        apds9960_gconf4_t reg_gconf4;
+        reg_gconf4.byte = p_apds->reg_shadow[APDS9960_GCONF4 - APDS9960_SHADOW_FIRST];
+        reg_gconf4.GFIFO_CLR = 0;
+        p_apds->reg_shadow[APDS9960_GCONF4 - APDS9960_SHADOW_FIRST] = reg_gconf4.byte;
+    }
+}
+
 /* [] END OF FILE */
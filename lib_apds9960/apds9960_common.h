@@ -39,6 +39,87 @@ ssize_t
 reg_write(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
     uint32_t data_len);
 
+// Address-only write triggering special function (IFORCE, *ICLEAR)
+bool
+reg_write_addr(apds9960_t *p_apds, uint8_t reg_addr);
+
+// Write block of shadowed registers only when it differs from shadow
+bool
+reg_update(apds9960_t *p_apds, uint8_t reg_addr, const uint8_t *p_data,
+    uint32_t data_len);
+
+// Writable configuration registers, reserved addresses excluded. Usable in
+// constant expressions.
+#define REG_IS_SHADOWED(a) \
+    ((((a) >= APDS9960_ENABLE) && ((a) <= APDS9960_CONFIG2) && \
+    ((a) != 0x82) && ((a) != 0x88) && ((a) != 0x8A)) || \
+    (((a) >= APDS9960_POFFSET_UR) && ((a) <= APDS9960_GCONF4) && \
+    ((a) != 0xA8)))
+
+bool
+reg_is_shadowed(uint8_t reg_addr);
+
+uint8_t
+reg_shadow8(const apds9960_t *p_apds, uint8_t reg_addr);
+
+// Configuration from register image indexed from APDS9960_SHADOW_FIRST
+void
+config_from_image(const uint8_t *p_image, apds9960_config_t *p_config);
+
+// ALS auto-ranging step for a sample read by apds9960_read_all()
+bool
+als_autorange_update(apds9960_t *p_apds, apds9960_sample_t *p_sample);
+
+// Re-centre ALS wake-on-change window after ALS interrupt or range change
+bool
+als_wake_update(apds9960_t *p_apds, const apds9960_sample_t *p_sample);
+
+// Presence detection step after proximity interrupt or at the drift
+// deadline. Returns PRESENCE_EVENT_* or -1 on error.
+int
+presence_update(apds9960_t *p_apds, uint8_t proximity,
+    const struct timespec *p_now);
+
+// True when baseline rise is pending, *p_rise_at is set to its time
+bool
+presence_is_rise_pending(const apds9960_t *p_apds, struct timespec *p_rise_at);
+
+// Sleep-after-interrupt accounting when service reads STATUS. Returns true
+// when the interrupt clear, which wakes the device, is to be held back.
+bool
+sai_sleep_begin(apds9960_t *p_apds, apds9960_status_t reg_status,
+    const struct timespec *p_now);
+
+// True when held device may be woken, *p_wake_at is set to that time
+bool
+sai_is_wake_due(apds9960_t *p_apds, struct timespec *p_wake_at);
+
+// Sleep-after-interrupt accounting after interrupt clear
+void
+sai_wake(apds9960_t *p_apds);
+
+// Read data_len bytes of FIFO datasets in bursts of up to chunk_size
+bool
+gesture_fifo_read(apds9960_t *p_apds, uint8_t *p_buffer, uint32_t data_len,
+    uint8_t chunk_size);
+
+// Wait until gesture FIFO holds level datasets, gives up after 500 ms with
+// *p_is_filled false. Returns false on bus error.
+bool
+gesture_fifo_wait_level(apds9960_t *p_apds, uint8_t level, bool *p_is_filled);
+
+void
+timespec_add_ms(struct timespec *p_ts, uint32_t ms);
+
+void
+timespec_add_us(struct timespec *p_ts, uint32_t us);
+
+bool
+timespec_is_zero(const struct timespec *p_ts);
+
+int64_t
+timespec_diff_ns(const struct timespec *p_end, const struct timespec *p_start);
+
 #ifdef __cplusplus
 }
 #endif
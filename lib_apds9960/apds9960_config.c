@@ -0,0 +1,207 @@
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+// Unchanged registers rewritten inside a burst rather than starting another
+// transaction, which costs start, address and register bytes
+#define CONFIG_BRIDGE_MAX       2
+
+// Image byte of register
+#define CONFIG_IMAGE(p, reg)    ((p)[(reg) - APDS9960_SHADOW_FIRST])
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Register image indexed from APDS9960_SHADOW_FIRST.
+ *
+ * Reserved addresses are left 0, they are never written.
+ *
+ * @param p_config Configuration.
+ * @param p_image Image of APDS9960_SHADOW_SIZE bytes.
+ */
+static void
+config_to_image(const apds9960_config_t *p_config, uint8_t *p_image);
+
+/**
+ * @brief Write changed registers after ENABLE in as few bursts as possible.
+ *
+ * A burst ends at a reserved or read-only address and when more than
+ * CONFIG_BRIDGE_MAX unchanged registers follow. GCONF4 is only written when
+ * changed, its GMODE is set by the device.
+ *
+ * @param p_apds Device descriptor.
+ * @param p_image Register image to load.
+ * @param p_writes Incremented per transaction.
+ *
+ * @return True on success.
+ */
+static bool
+config_write_runs(apds9960_t *p_apds, const uint8_t *p_image,
+    uint32_t *p_writes);
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+void
+apds9960_config_get(const apds9960_t *p_apds, apds9960_config_t *p_config)
+{
+    config_from_image(p_apds->reg_shadow, p_config);
+}
+
+bool
+apds9960_config_apply(apds9960_t *p_apds, const apds9960_config_t *p_config)
+{
+    uint8_t image[APDS9960_SHADOW_SIZE];
+    uint8_t reg_enable = reg_shadow8(p_apds, APDS9960_ENABLE);
+    uint32_t writes = 0;
+    bool b_is_all_ok = true;
+
+    config_to_image(p_config, image);
+
+    // Engines being turned off stop before their settings change
+    if ((reg_enable & image[0]) != reg_enable)
+    {
+        reg_enable &= image[0];
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable);
+        writes++;
+    }
+
+    b_is_all_ok = b_is_all_ok && config_write_runs(p_apds, image, &writes);
+
+    // Engines being turned on start with new settings
+    if (b_is_all_ok && (reg_enable != image[0]))
+    {
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &image[0]);
+        writes++;
+    }
+
+    DEBUG_DEV("Configuration applied in %u write(s)", __FUNCTION__, p_apds,
+        writes);
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error applying configuration.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+void
+config_from_image(const uint8_t *p_image, apds9960_config_t *p_config)
+{
+    memset(p_config, 0, sizeof(apds9960_config_t));
+
+    p_config->enable.byte = CONFIG_IMAGE(p_image, APDS9960_ENABLE);
+    p_config->atime = CONFIG_IMAGE(p_image, APDS9960_ATIME);
+    p_config->wtime = CONFIG_IMAGE(p_image, APDS9960_WTIME);
+    p_config->ailt = (uint16_t)(CONFIG_IMAGE(p_image, APDS9960_AILTL) |
+        (CONFIG_IMAGE(p_image, APDS9960_AILTH) << 8));
+    p_config->aiht = (uint16_t)(CONFIG_IMAGE(p_image, APDS9960_AIHTL) |
+        (CONFIG_IMAGE(p_image, APDS9960_AIHTH) << 8));
+    p_config->pilt = CONFIG_IMAGE(p_image, APDS9960_PILT);
+    p_config->piht = CONFIG_IMAGE(p_image, APDS9960_PIHT);
+    p_config->pers.byte = CONFIG_IMAGE(p_image, APDS9960_PERS);
+    p_config->config1.byte = CONFIG_IMAGE(p_image, APDS9960_CONFIG1);
+    p_config->ppulse.byte = CONFIG_IMAGE(p_image, APDS9960_PPULSE);
+    p_config->control.byte = CONFIG_IMAGE(p_image, APDS9960_CONTROL);
+    p_config->config2.byte = CONFIG_IMAGE(p_image, APDS9960_CONFIG2);
+    p_config->poffset_ur = CONFIG_IMAGE(p_image, APDS9960_POFFSET_UR);
+    p_config->poffset_dl = CONFIG_IMAGE(p_image, APDS9960_POFFSET_DL);
+    p_config->config3.byte = CONFIG_IMAGE(p_image, APDS9960_CONFIG3);
+    p_config->gpenth = CONFIG_IMAGE(p_image, APDS9960_GPENTH);
+    p_config->gexth = CONFIG_IMAGE(p_image, APDS9960_GEXTH);
+    p_config->gconf1.byte = CONFIG_IMAGE(p_image, APDS9960_GCONF1);
+    p_config->gconf2.byte = CONFIG_IMAGE(p_image, APDS9960_GCONF2);
+    p_config->goffset_u = CONFIG_IMAGE(p_image, APDS9960_GOFFSET_U);
+    p_config->goffset_d = CONFIG_IMAGE(p_image, APDS9960_GOFFSET_D);
+    p_config->gpulse.byte = CONFIG_IMAGE(p_image, APDS9960_GPULSE);
+    p_config->goffset_l = CONFIG_IMAGE(p_image, APDS9960_GOFFSET_L);
+    p_config->goffset_r = CONFIG_IMAGE(p_image, APDS9960_GOFFSET_R);
+    p_config->gconf3.byte = CONFIG_IMAGE(p_image, APDS9960_GCONF3);
+    p_config->gconf4.byte = CONFIG_IMAGE(p_image, APDS9960_GCONF4);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+config_to_image(const apds9960_config_t *p_config, uint8_t *p_image)
+{
+    memset(p_image, 0, APDS9960_SHADOW_SIZE);
+
+    CONFIG_IMAGE(p_image, APDS9960_ENABLE) = p_config->enable.byte;
+    CONFIG_IMAGE(p_image, APDS9960_ATIME) = p_config->atime;
+    CONFIG_IMAGE(p_image, APDS9960_WTIME) = p_config->wtime;
+    CONFIG_IMAGE(p_image, APDS9960_AILTL) = (uint8_t)(p_config->ailt & 0xFF);
+    CONFIG_IMAGE(p_image, APDS9960_AILTH) = (uint8_t)(p_config->ailt >> 8);
+    CONFIG_IMAGE(p_image, APDS9960_AIHTL) = (uint8_t)(p_config->aiht & 0xFF);
+    CONFIG_IMAGE(p_image, APDS9960_AIHTH) = (uint8_t)(p_config->aiht >> 8);
+    CONFIG_IMAGE(p_image, APDS9960_PILT) = p_config->pilt;
+    CONFIG_IMAGE(p_image, APDS9960_PIHT) = p_config->piht;
+    CONFIG_IMAGE(p_image, APDS9960_PERS) = p_config->pers.byte;
+    CONFIG_IMAGE(p_image, APDS9960_CONFIG1) = p_config->config1.byte;
+    CONFIG_IMAGE(p_image, APDS9960_PPULSE) = p_config->ppulse.byte;
+    CONFIG_IMAGE(p_image, APDS9960_CONTROL) = p_config->control.byte;
+    CONFIG_IMAGE(p_image, APDS9960_CONFIG2) = p_config->config2.byte;
+    CONFIG_IMAGE(p_image, APDS9960_POFFSET_UR) = p_config->poffset_ur;
+    CONFIG_IMAGE(p_image, APDS9960_POFFSET_DL) = p_config->poffset_dl;
+    CONFIG_IMAGE(p_image, APDS9960_CONFIG3) = p_config->config3.byte;
+    CONFIG_IMAGE(p_image, APDS9960_GPENTH) = p_config->gpenth;
+    CONFIG_IMAGE(p_image, APDS9960_GEXTH) = p_config->gexth;
+    CONFIG_IMAGE(p_image, APDS9960_GCONF1) = p_config->gconf1.byte;
+    CONFIG_IMAGE(p_image, APDS9960_GCONF2) = p_config->gconf2.byte;
+    CONFIG_IMAGE(p_image, APDS9960_GOFFSET_U) = p_config->goffset_u;
+    CONFIG_IMAGE(p_image, APDS9960_GOFFSET_D) = p_config->goffset_d;
+    CONFIG_IMAGE(p_image, APDS9960_GPULSE) = p_config->gpulse.byte;
+    CONFIG_IMAGE(p_image, APDS9960_GOFFSET_L) = p_config->goffset_l;
+    CONFIG_IMAGE(p_image, APDS9960_GOFFSET_R) = p_config->goffset_r;
+    CONFIG_IMAGE(p_image, APDS9960_GCONF3) = p_config->gconf3.byte;
+    CONFIG_IMAGE(p_image, APDS9960_GCONF4) = p_config->gconf4.byte;
+}
+
+static bool
+config_write_runs(apds9960_t *p_apds, const uint8_t *p_image,
+    uint32_t *p_writes)
+{
+    uint32_t first = 0;
+    uint32_t last = 0;
+    bool b_is_all_ok = true;
+
+    for (uint32_t addr = APDS9960_ATIME;
+        b_is_all_ok && (addr <= APDS9960_SHADOW_LAST + 1); addr++)
+    {
+        bool b_is_writable = (addr <= APDS9960_SHADOW_LAST) &&
+            reg_is_shadowed((uint8_t)addr);
+        bool b_is_changed = b_is_writable &&
+            (CONFIG_IMAGE(p_image, addr) != reg_shadow8(p_apds, (uint8_t)addr));
+
+        if (b_is_changed)
+        {
+            if (first == 0)
+            {
+                first = addr;
+            }
+            last = addr;
+        }
+        else if ((first != 0) && (!b_is_writable ||
+            (addr == APDS9960_GCONF4) || (addr - last > CONFIG_BRIDGE_MAX)))
+        {
+            // Run ends, bridged registers after last are not needed
+            b_is_all_ok = (reg_write(p_apds, (uint8_t)first,
+                &CONFIG_IMAGE(p_image, first), last - first + 1) != -1);
+            (*p_writes)++;
+            first = 0;
+        }
+    }
+
+    return b_is_all_ok;
+}
+
+/* [] END OF FILE */
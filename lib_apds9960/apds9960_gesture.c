@@ -7,24 +7,49 @@
 #include "lib_apds9960.h"
 #include "apds9960_common.h"
 
+// Default decoder parameters
 #define GESTURE_THOLD_OUT   10  // Gesture Out Threshold
 #define GESTURE_SENS_1      50
 #define GESTURE_SENS_2      20
+#define GESTURE_NEAR_COUNT  10  // Still steps needed for Near-Far gesture
+#define GESTURE_FAR_COUNT   2   // Moving steps needed for Near-Far gesture
 
 #define FIFO_PAUSE_TIME_MS  30  // Wait period between FIFO reads
 
+#define GESTURE_FIFO_SIZE   128 // 32 datasets of U/D/L/R bytes
+
+#define SELFTEST_WAIT_MS    5   // FIFO fill poll period during self-test
+#define SELFTEST_TIMEOUT_MS 500 // Maximum wait for FIFO to fill
+#define SELFTEST_TOLERANCE  8   // Allowed per-channel mean deviation
+
 /*******************************************************************************
 * Forward declarations of private functions
 *******************************************************************************/
 
 static void
-gesture_reset_params(apds9960_t *p_apds);
+gesture_reset_params(apds9960_gesture_decoder_t *p_dec);
+
+static void
+gesture_feed_dataset(apds9960_gesture_decoder_t *p_dec,
+    const uint8_t *p_dataset);
+
+static bool
+gesture_process_data(apds9960_gesture_decoder_t *p_dec);
+
+static bool
+gesture_decode(apds9960_gesture_decoder_t *p_dec);
+
+static void
+gesture_event_push(apds9960_t *p_apds, int gesture, uint32_t dset_count,
+    const struct timespec *p_now);
 
 static bool
-gesture_process_data(apds9960_t *p_apds);
+gesture_fifo_drain(apds9960_t *p_apds, uint8_t *p_buffer, uint8_t *p_level,
+    apds9960_gstatus_t *p_gstatus);
 
 static bool
-gesture_decode(apds9960_t *p_apds);
+gesture_fifo_check_chunk(apds9960_t *p_apds, uint8_t chunk_size,
+    bool *p_is_passed);
 
 /*******************************************************************************
 * Global variables
@@ -41,7 +66,7 @@ apds9960_gesture_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
     uint8_t reg_byte;
     bool b_is_all_ok = false;
 
-    gesture_reset_params(p_apds);
+    gesture_reset_params(&p_apds->gesture_decoder);
 
     // WTIME: Proximity wait time 2.78 ms
     reg_byte = 0xFF;
@@ -59,13 +84,9 @@ apds9960_gesture_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
         // CONFIG2
         // -- LED_BOOST: 300 %
         apds9960_config2_t reg_config2;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_CONFIG2, &reg_config2.byte);
-
-        if (b_is_all_ok)
-        {
-            reg_config2.LED_BOOST = CONFIG2_LED_BOOST_300;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_CONFIG2, &reg_config2.byte);
-        }
+        reg_config2.byte = reg_shadow8(p_apds, APDS9960_CONFIG2);
+        reg_config2.LED_BOOST = CONFIG2_LED_BOOST_300;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_CONFIG2, &reg_config2.byte);
     }
 
     if (b_is_all_ok)
@@ -74,14 +95,10 @@ apds9960_gesture_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
         // -- GMODE: Gesture Mode Enabled
         // -- GIEN: b_is_interrupt_enabled
         apds9960_gconf4_t reg_gconf4;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-
-        if (b_is_all_ok)
-        {
-            reg_gconf4.GMODE = 1;
-            reg_gconf4.GIEN = b_is_interrupt_enabled;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-        }
+        reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+        reg_gconf4.GMODE = 1;
+        reg_gconf4.GIEN = b_is_interrupt_enabled;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
     }
 
     if (b_is_all_ok)
@@ -92,15 +109,12 @@ apds9960_gesture_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
         // -- WEN: Wait Enable
         // -- PEN: Proximity Enable
         apds9960_enable_t reg_enable;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        if (b_is_all_ok)
-        {
-            reg_enable.PON = 1;
-            reg_enable.GEN = 1;
-            reg_enable.WEN = 1;
-            reg_enable.PEN = 1;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        }
+        reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+        reg_enable.PON = 1;
+        reg_enable.GEN = 1;
+        reg_enable.WEN = 1;
+        reg_enable.PEN = 1;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
     }
 
     if (!b_is_all_ok)
@@ -116,31 +130,25 @@ apds9960_gesture_disable(apds9960_t *p_apds)
 {
     bool b_is_all_ok = false;
 
-    gesture_reset_params(p_apds);
+    gesture_reset_params(&p_apds->gesture_decoder);
 
     // GCONF4
     // -- GMODE: Gesture Mode Disabled
     // -- GIEN: Interrupt Disabled
     apds9960_gconf4_t reg_gconf4;
-    b_is_all_ok = reg_read8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-    if (b_is_all_ok)
-    {
-        reg_gconf4.GMODE = 0;
-        reg_gconf4.GIEN = 0;
-        b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-    }
+    reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+    reg_gconf4.GMODE = 0;
+    reg_gconf4.GIEN = 0;
+    b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
 
     if (b_is_all_ok)
     {
         // ENABLE
         // -- GEN: Gesture Disable
         apds9960_enable_t reg_enable;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        if (b_is_all_ok)
-        {
-            reg_enable.GEN = 0;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        }
+        reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+        reg_enable.GEN = 0;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
     }
 
     if (!b_is_all_ok)
@@ -171,108 +179,221 @@ apds9960_gesture_read(apds9960_t *p_apds)
 {
     const struct timespec FIFO_DELAY = { 0, FIFO_PAUSE_TIME_MS * 1000000 };
 
-    uint8_t fifo_level = 0;
-    ssize_t bytes_read = 0;
-    uint8_t ds_buffer[128];
+    struct timespec now;
+    struct timespec next_deadline;
     int result = -1;
-    int idx;
 
     bool b_is_all_ok = false;
     bool b_is_valid;            // Gesture is available
 
     apds9960_enable_t reg_enable;
-    apds9960_gesture_data_t *p_gdata = &p_apds->gesture_data;
 
     // Make sure that power and gesture is on and gesture is available
-    b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-    if (b_is_all_ok)
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    b_is_all_ok = apds9960_gesture_is_valid(p_apds, &b_is_valid);
+    if (b_is_all_ok && (!b_is_valid || !reg_enable.PON || !reg_enable.GEN))
     {
-        b_is_all_ok = apds9960_gesture_is_valid(p_apds, &b_is_valid);
-        if (b_is_all_ok && (!b_is_valid || !reg_enable.PON || !reg_enable.GEN))
-        {
-            b_is_all_ok = false;
-        }
+        b_is_all_ok = false;
     }
 
-    // Endless loop as long as gestures are available
+    // Step gesture state machine as long as gestures are available
     while (b_is_all_ok)
     {
         // Wait for FIFO to fill up
         nanosleep(&FIFO_DELAY, NULL);
 
-        // Get current gesture availability
-        b_is_all_ok = apds9960_gesture_is_valid(p_apds, &b_is_valid);
-        if (!b_is_all_ok)
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        result = apds9960_gesture_poll(p_apds, &now, &next_deadline);
+
+        if ((result == -1) || timespec_is_zero(&next_deadline))
         {
-            // Cannot obtain gesture validity
-            result = -1;
             break;
         }
+    }
+
+    return result;
+}
+
+int
+apds9960_gesture_poll(apds9960_t *p_apds, const struct timespec *p_now,
+    struct timespec *p_next_deadline)
+{
+    uint8_t fifo_level = 0;
+    uint8_t ds_buffer[GESTURE_FIFO_SIZE];
+    int result = GESTURE_DIR_NONE;
+    int gesture;
+    uint32_t dset_count;
+
+    apds9960_enable_t reg_enable;
+    apds9960_gstatus_t reg_gstatus;
+    apds9960_gesture_decoder_t *p_dec = &p_apds->gesture_decoder;
+    struct timespec now;
+
+    if (p_now)
+    {
+        now = *p_now;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    // No further step needed unless a gesture is in progress
+    p_next_deadline->tv_sec = 0;
+    p_next_deadline->tv_nsec = 0;
+
+    // Nothing to do while power or gesture engine is off
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    if (!reg_enable.PON || !reg_enable.GEN)
+    {
+        p_apds->b_is_gesture_active = false;
+    }
+    // Get current gesture availability and FIFO content
+    else if (!gesture_fifo_drain(p_apds, ds_buffer, &fifo_level, &reg_gstatus))
+    {
+        ERROR("Cannot read FIFO data.", __FUNCTION__);
+        result = -1;
+    }
+    else
+    {
+        if (p_apds->p_gesture_hook)
+        {
+            p_apds->p_gesture_hook(p_apds->p_gesture_hook_ctx, &now,
+                reg_gstatus, fifo_level, ds_buffer);
+        }
+
+        if (reg_gstatus.GVALID && !p_apds->b_is_gesture_active)
+        {
+            p_apds->b_is_gesture_active = true;
+            p_apds->gesture_start = now;
+            p_apds->gesture_last_event = GESTURE_DIR_NONE;
+        }
 
-        if (!b_is_valid)
+        // Decoder handles both gesture segments and gesture end
+        gesture = apds9960_gesture_decoder_feed(p_dec, reg_gstatus.GVALID,
+            ds_buffer, fifo_level, &dset_count);
+        if (gesture != GESTURE_DIR_NONE)
+        {
+            gesture_event_push(p_apds, gesture, dset_count, &now);
+            p_apds->gesture_start = now;
+        }
+
+        if (p_apds->b_is_gesture_active && !reg_gstatus.GVALID)
         {
             // No more gestures available
-            // Use accumulated data to decode gesture
-            gesture_decode(p_apds);
-            result = p_apds->gesture_motion;
-            gesture_reset_params(p_apds);
-            break;
+            // Report last gesture of a multi-gesture sequence
+            result = p_apds->gesture_last_event;
+            p_apds->b_is_gesture_active = false;
         }
-        else
+        else if (p_apds->b_is_gesture_active)
         {
-            // Get current FIFO level
-            b_is_all_ok = reg_read8(p_apds, APDS9960_GFLVL, &fifo_level);
+            // Let FIFO fill up before next step
+            *p_next_deadline = now;
+            timespec_add_ms(p_next_deadline, FIFO_PAUSE_TIME_MS);
+        }
+    }
 
-            if (!b_is_all_ok)
-            {
-                // Cannot get FIFO level
-                result = -1;
-                break;
-            }
+    return result;
+}
 
-            // If there's data in the FIFO, copy datasets into buffer
-            if (fifo_level > 0)
-            {
-                p_gdata->dset_count = 0;
+size_t
+apds9960_gesture_events_read(apds9960_t *p_apds,
+    apds9960_gesture_event_t *p_events, size_t max_events)
+{
+    apds9960_gesture_events_t *p_ring = &p_apds->gesture_events;
+    size_t count = 0;
 
-                // Read FIFO
-                for (idx = 0; idx < fifo_level; idx ++)
-                {
-                    // Seems that reading more than 8 bytes at a time from FIFO 
-                    // produces erratic results
-                    bytes_read = reg_read(p_apds, APDS9960_GFIFO_U, ds_buffer, 4);
+    while ((count < max_events) && (p_ring->count > 0))
+    {
+        p_events[count++] = p_ring->events[p_ring->head];
+        p_ring->head = (uint8_t)((p_ring->head + 1) % APDS9960_GESTURE_EVENTS_MAX);
+        p_ring->count--;
+    }
 
-                    if (bytes_read == -1)
-                    {
-                        ERROR("Cannot read FIFO data.", __FUNCTION__);
-                        result = -1;
-                        break;
-                    }
+    return count;
+}
 
-                    // Sort datasets from FIFO into U/D/L/R
-                    p_gdata->u[p_gdata->dset_count] = ds_buffer[0];
-                    p_gdata->d[p_gdata->dset_count] = ds_buffer[1];
-                    p_gdata->l[p_gdata->dset_count] = ds_buffer[2];
-                    p_gdata->r[p_gdata->dset_count] = ds_buffer[3];
+void
+apds9960_gesture_decoder_init(apds9960_gesture_decoder_t *p_dec,
+    const apds9960_gesture_params_t *p_params)
+{
+    if (p_params)
+    {
+        p_dec->params = *p_params;
+    }
+    else
+    {
+        apds9960_gesture_params_default(&p_dec->params);
+    }
 
-                    p_gdata->dset_count++;
-                }
+    gesture_reset_params(p_dec);
+}
 
-                // At this point p_gdata holds current gesture datasets
-                // p_gdata->dset_count contains number of valid datasets
+void
+apds9960_gesture_params_default(apds9960_gesture_params_t *p_params)
+{
+    p_params->thold_out = GESTURE_THOLD_OUT;
+    p_params->sens_1 = GESTURE_SENS_1;
+    p_params->sens_2 = GESTURE_SENS_2;
+    p_params->near_count = GESTURE_NEAR_COUNT;
+    p_params->far_count = GESTURE_FAR_COUNT;
+}
 
-                // Filter and process gesture data
-                if (gesture_process_data(p_apds))
-                {
-                    if (gesture_decode(p_apds))
-                    {
-                        // Process multi-gesture sequences here or quit
-                        // at the first decoded valid gesture
-#   	                    ifdef APDS9960_DEBUG
-                        DEBUG("Multi gesture %d\n", __FUNCTION__, p_apds->gesture_motion);
-#                           endif
-                    }
-                }
+void
+apds9960_gesture_set_params(apds9960_t *p_apds,
+    const apds9960_gesture_params_t *p_params)
+{
+    apds9960_gesture_decoder_init(&p_apds->gesture_decoder, p_params);
+}
+
+void
+apds9960_gesture_decoder_reset(apds9960_gesture_decoder_t *p_dec)
+{
+    gesture_reset_params(p_dec);
+}
+
+int
+apds9960_gesture_decoder_feed(apds9960_gesture_decoder_t *p_dec,
+    bool b_is_valid, const uint8_t *p_datasets, uint8_t dataset_count,
+    uint32_t *p_dset_count)
+{
+    int result = GESTURE_DIR_NONE;
+    uint8_t idx;
+
+    // Feed datasets from FIFO to decoder one at a time
+    for (idx = 0; idx < dataset_count; idx++)
+    {
+        gesture_feed_dataset(p_dec, &p_datasets[idx * 4]);
+    }
+
+    if (p_dset_count)
+    {
+        *p_dset_count = p_dec->data.dset_count;
+    }
+
+    if (!b_is_valid)
+    {
+        // No more gestures available
+        // Use accumulated data to decode gesture
+        if ((p_dec->data.dset_count > 0) && gesture_decode(p_dec))
+        {
+            result = p_dec->motion;
+        }
+
+        gesture_reset_params(p_dec);
+    }
+    else if (dataset_count > 0)
+    {
+        // Filter and process gesture data. A gesture decoded after the
+        // hand has left the field is one of a multi-gesture sequence.
+        if (gesture_process_data(p_dec) && p_dec->data.b_is_closed)
+        {
+            if (gesture_decode(p_dec))
+            {
+                // Report gesture and start decoding the next one
+                DEBUG("Multi gesture %d\n", __FUNCTION__, p_dec->motion);
+                result = p_dec->motion;
+                gesture_reset_params(p_dec);
             }
         }
     }
@@ -280,165 +401,303 @@ apds9960_gesture_read(apds9960_t *p_apds)
     return result;
 }
 
+void
+apds9960_gesture_set_hook(apds9960_t *p_apds, apds9960_gesture_hook_t p_hook,
+    void *p_ctx)
+{
+    p_apds->p_gesture_hook = p_hook;
+    p_apds->p_gesture_hook_ctx = p_ctx;
+}
 
-/*******************************************************************************
-* Private function definitions
-*******************************************************************************/
-
-static void
-gesture_reset_params(apds9960_t *p_apds)
+bool
+apds9960_gesture_set_fifo_chunk(apds9960_t *p_apds, uint8_t chunk_size)
 {
-    p_apds->gesture_data.dset_count = 0;
-    p_apds->gesture_delta.lr = 0;
-    p_apds->gesture_delta.ud = 0;
-    p_apds->gesture_count.lr = 0;
-    p_apds->gesture_count.ud = 0;
-    p_apds->gesture_count.near = 0;
-    p_apds->gesture_count.far = 0;
-    p_apds->gesture_state = 0;
-    p_apds->gesture_motion = GESTURE_DIR_NONE;
+    bool b_is_all_ok = false;
+
+    // Whole datasets only, at most the complete FIFO
+    if ((chunk_size >= 4) && (chunk_size <= GESTURE_FIFO_SIZE) &&
+        ((chunk_size % 4) == 0))
+    {
+        p_apds->gesture_fifo_chunk = chunk_size;
+        b_is_all_ok = true;
+    }
+    else
+    {
+        ERROR("Invalid FIFO chunk size %d.", __FUNCTION__, chunk_size);
+    }
+
+    return b_is_all_ok;
 }
 
-static bool
-gesture_process_data(apds9960_t *p_apds)
+bool
+apds9960_gesture_fifo_selftest(apds9960_t *p_apds, uint8_t *p_chunk_size)
 {
-    uint8_t u_first = 0;
-    uint8_t d_first = 0;
-    uint8_t l_first = 0;
-    uint8_t r_first = 0;
-    uint8_t u_last = 0;
-    uint8_t d_last = 0;
-    uint8_t l_last = 0;
-    uint8_t r_last = 0;
-    int ud_ratio_first;
-    int lr_ratio_first;
-    int ud_ratio_last;
-    int lr_ratio_last;
-    int ud_delta;
-    int lr_delta;
-    uint8_t idx;
+    const uint8_t candidates[] = { 128, 64, 32, 16, 8 };
 
-    // Shortcuts to Gesture data structs
-    apds9960_gesture_data_t *p_gdata = &p_apds->gesture_data;
-    apds9960_gesture_delta_t *p_gdelta = &p_apds->gesture_delta;
-    apds9960_gesture_count_t *p_gcount = &p_apds->gesture_count;
+    uint8_t safe_chunk = 4;
+    uint8_t saved_enable = reg_shadow8(p_apds, APDS9960_ENABLE);
+    uint8_t saved_gconf4 = reg_shadow8(p_apds, APDS9960_GCONF4);
+    uint8_t saved_gexth = reg_shadow8(p_apds, APDS9960_GEXTH);
+    uint8_t gexth = 0;
+    apds9960_enable_t reg_enable;
+    apds9960_gconf4_t reg_gconf4;
+    bool b_is_all_ok;
 
-    bool b_is_all_ok = false;
+    // Force gesture engine to run regardless of proximity entry threshold,
+    // zero exit threshold keeps it running with nothing in front of sensor
+    reg_enable.byte = saved_enable;
+    reg_enable.PON = 1;
+    reg_enable.PEN = 1;
+    reg_enable.GEN = 1;
+    b_is_all_ok = reg_write8(p_apds, APDS9960_GEXTH, &gexth) &&
+        reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
 
-    DEBUG("Processing cycles %d", __FUNCTION__, p_gdata->dset_count);
+    if (b_is_all_ok)
+    {
+        reg_gconf4.byte = saved_gconf4;
+        reg_gconf4.GMODE = 1;
+        reg_gconf4.GIEN = 0;
+        reg_gconf4.GFIFO_CLR = 1;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
+    }
 
-# 	ifdef APDS9960_DEBUG
-    log_printf("U: ");
-    for (idx = 0; idx < p_gdata->dset_count; idx++)
+    // Largest chunk size passing the check wins
+    for (size_t idx = 0; b_is_all_ok && (idx < sizeof(candidates)); idx++)
     {
-        log_printf("%02X ", p_gdata->u[idx]);
+        bool b_is_passed = false;
+
+        b_is_all_ok = gesture_fifo_check_chunk(p_apds, candidates[idx],
+            &b_is_passed);
+
+        DEBUG_DEV("FIFO chunk %d bytes: %s", __FUNCTION__, p_apds,
+            candidates[idx], b_is_passed ? "ok" : "failed");
+
+        if (b_is_all_ok && b_is_passed)
+        {
+            safe_chunk = candidates[idx];
+            break;
+        }
     }
-    log_printf("\n");
 
-    log_printf("D: ");
-    for (idx = 0; idx < p_gdata->dset_count; idx++)
+    // Restore gesture configuration, discard test data
+    reg_gconf4.byte = saved_gconf4;
+    reg_gconf4.GFIFO_CLR = 1;
+    if (!reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte) ||
+        !reg_write8(p_apds, APDS9960_GEXTH, &saved_gexth) ||
+        !reg_write8(p_apds, APDS9960_ENABLE, &saved_enable))
     {
-        log_printf("%02X ", p_gdata->d[idx]);
+        b_is_all_ok = false;
     }
-    log_printf("\n");
 
-    log_printf("L: ");
-    for (idx = 0; idx < p_gdata->dset_count; idx++)
+    if (b_is_all_ok)
     {
-        log_printf("%02X ", p_gdata->l[idx]);
+        p_apds->gesture_fifo_chunk = safe_chunk;
+        *p_chunk_size = safe_chunk;
     }
-    log_printf("\n");
+    else
+    {
+        ERROR("FIFO self-test failed.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
 
-    log_printf("R: ");
-    for (idx = 0; idx < p_gdata->dset_count; idx++)
+bool
+gesture_fifo_read(apds9960_t *p_apds, uint8_t *p_buffer, uint32_t data_len,
+    uint8_t chunk_size)
+{
+    bool b_is_all_ok = true;
+    uint32_t offset = 0;
+
+    // Some hosts produce erratic results on long FIFO bursts, chunk size
+    // can be tuned by apds9960_gesture_fifo_selftest
+    if (chunk_size < 4)
     {
-        log_printf("%02X ", p_gdata->r[idx]);
+        chunk_size = 4;
     }
-    log_printf("\n");
-#   endif
 
+    while (b_is_all_ok && (offset < data_len))
+    {
+        uint32_t len = data_len - offset;
 
-    // At least 5 gesture integration cycles are required for processing
-    // Check gesture data bounds
-    if ((p_gdata->dset_count > 4) && (p_gdata->dset_count <= 32))
+        if (len > chunk_size)
+        {
+            len = chunk_size;
+        }
+
+        // FIFO address pointer wraps from GFIFO_R back to GFIFO_U
+        b_is_all_ok = (reg_read(p_apds, APDS9960_GFIFO_U, &p_buffer[offset],
+            len) != -1);
+        offset += len;
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+gesture_fifo_wait_level(apds9960_t *p_apds, uint8_t level, bool *p_is_filled)
+{
+    const struct timespec POLL_DELAY = { 0, SELFTEST_WAIT_MS * 1000000 };
+
+    uint8_t fifo_level = 0;
+    bool b_is_all_ok = true;
+    int waited_ms = 0;
+
+    *p_is_filled = false;
+
+    while (b_is_all_ok && !*p_is_filled)
     {
-        // Find the first sample where all UDLR values are above Out threshold
-        for (idx = 0; idx < p_gdata->dset_count; idx++)
+        b_is_all_ok = reg_read8(p_apds, APDS9960_GFLVL, &fifo_level);
+        *p_is_filled = (fifo_level >= level);
+
+        if (b_is_all_ok && !*p_is_filled)
         {
-            if ((p_gdata->u[idx] > GESTURE_THOLD_OUT) &&
-                (p_gdata->d[idx] > GESTURE_THOLD_OUT) &&
-                (p_gdata->l[idx] > GESTURE_THOLD_OUT) &&
-                (p_gdata->r[idx] > GESTURE_THOLD_OUT))
+            if (waited_ms >= SELFTEST_TIMEOUT_MS)
             {
-                u_first = p_gdata->u[idx];
-                d_first = p_gdata->d[idx];
-                l_first = p_gdata->l[idx];
-                r_first = p_gdata->r[idx];
                 break;
             }
+
+            nanosleep(&POLL_DELAY, NULL);
+            waited_ms += SELFTEST_WAIT_MS;
         }
+    }
+
+    return b_is_all_ok;
+}
+
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+gesture_reset_params(apds9960_gesture_decoder_t *p_dec)
+{
+    memset(&p_dec->data, 0, sizeof(apds9960_gesture_data_t));
+    p_dec->delta.lr = 0;
+    p_dec->delta.ud = 0;
+    p_dec->count.lr = 0;
+    p_dec->count.ud = 0;
+    p_dec->count.near = 0;
+    p_dec->count.far = 0;
+    p_dec->state = 0;
+    p_dec->motion = GESTURE_DIR_NONE;
+}
+
+static void
+gesture_feed_dataset(apds9960_gesture_decoder_t *p_dec,
+    const uint8_t *p_dataset)
+{
+    apds9960_gesture_data_t *p_gdata = &p_dec->data;
 
-        // Check "first" data validity, all UDLR values must be nonzero
-        if ((u_first != 0) && (d_first != 0) && 
-            (l_first != 0) && (r_first != 0))
+    p_gdata->dset_count++;
+
+    // Track the first and the last sample where all UDLR values are above
+    // Out threshold over the whole gesture
+    if ((p_dataset[0] > p_dec->params.thold_out) &&
+        (p_dataset[1] > p_dec->params.thold_out) &&
+        (p_dataset[2] > p_dec->params.thold_out) &&
+        (p_dataset[3] > p_dec->params.thold_out))
+    {
+        if (!p_gdata->b_has_first)
         {
-            b_is_all_ok = true;
+            memcpy(p_gdata->first, p_dataset, 4);
+            p_gdata->b_has_first = true;
+
+            // Movement steps are measured from the entry point on
+            p_gdata->ud_ratio_prev = ((p_dataset[0] - p_dataset[1]) * 100) /
+                (p_dataset[0] + p_dataset[1]);
+            p_gdata->lr_ratio_prev = ((p_dataset[2] - p_dataset[3]) * 100) /
+                (p_dataset[2] + p_dataset[3]);
+        }
 
-            // Find the last sample where all UDLR values are above Out threshold
-            for (idx = (uint8_t)(p_gdata->dset_count - 1); idx >= 0; idx--)
-            {
-                if ((p_gdata->u[idx] > GESTURE_THOLD_OUT) &&
-                    (p_gdata->d[idx] > GESTURE_THOLD_OUT) &&
-                    (p_gdata->l[idx] > GESTURE_THOLD_OUT) &&
-                    (p_gdata->r[idx] > GESTURE_THOLD_OUT))
-                {
-                    u_last = p_gdata->u[idx];
-                    d_last = p_gdata->d[idx];
-                    l_last = p_gdata->l[idx];
-                    r_last = p_gdata->r[idx];
-                    break;
-                }
-            }
+        memcpy(p_gdata->last, p_dataset, 4);
+        p_gdata->b_is_closed = false;
+    }
+    else if (p_gdata->b_has_first)
+    {
+        // Hand has left the field after entering it
+        p_gdata->b_is_closed = true;
+    }
+}
+
+static bool
+gesture_process_data(apds9960_gesture_decoder_t *p_dec)
+{
+    int ud_ratio_first;
+    int lr_ratio_first;
+    int ud_ratio_last;
+    int lr_ratio_last;
+    int ud_delta;
+    int lr_delta;
+    int ud_step;
+    int lr_step;
+
+    // Shortcuts to Gesture data structs
+    apds9960_gesture_data_t *p_gdata = &p_dec->data;
+    apds9960_gesture_delta_t *p_gdelta = &p_dec->delta;
+    apds9960_gesture_count_t *p_gcount = &p_dec->count;
+    const apds9960_gesture_params_t *p_params = &p_dec->params;
+
+    const uint8_t *p_first = p_gdata->first;
+    const uint8_t *p_last = p_gdata->last;
+
+    bool b_is_all_ok = false;
+
+    DEBUG("Processing cycles %u", __FUNCTION__, p_gdata->dset_count);
+
+    // At least 5 gesture integration cycles are required for processing
+    // "First" data must exist, its UDLR values are all nonzero then
+    if (p_gdata->dset_count > 4)
+    {
+        if (p_gdata->b_has_first)
+        {
+            b_is_all_ok = true;
         }
         else
         {
-            DEBUG("Some first values are zero, skipping.", __FUNCTION__);
+            DEBUG("No values above threshold yet, skipping.", __FUNCTION__);
         }
     }
 
     if (b_is_all_ok)
     {
         // Calculate the first vs. last ratio of up/down and left/right
-        ud_ratio_first = ((u_first - d_first) * 100) / (u_first + d_first);
-        lr_ratio_first = ((l_first - r_first) * 100) / (l_first + r_first);
-        ud_ratio_last = ((u_last - d_last) * 100) / (u_last + d_last);
-        lr_ratio_last = ((l_last - r_last) * 100) / (l_last + r_last);
+        ud_ratio_first = ((p_first[0] - p_first[1]) * 100) / (p_first[0] + p_first[1]);
+        lr_ratio_first = ((p_first[2] - p_first[3]) * 100) / (p_first[2] + p_first[3]);
+        ud_ratio_last = ((p_last[0] - p_last[1]) * 100) / (p_last[0] + p_last[1]);
+        lr_ratio_last = ((p_last[2] - p_last[3]) * 100) / (p_last[2] + p_last[3]);
 
         DEBUG("First: U:%d D:%d L:%d R:%d", __FUNCTION__,
-            u_first, d_first, l_first, r_first);
+            p_first[0], p_first[1], p_first[2], p_first[3]);
         DEBUG("Last: U:%d D:%d L:%d R:%d", __FUNCTION__,
-            u_last, d_last, l_last, r_last);
+            p_last[0], p_last[1], p_last[2], p_last[3]);
         DEBUG("Ratios: UD Fi/La:%d/%d LR Fi/La:%d/%d", __FUNCTION__, 
             ud_ratio_first, ud_ratio_last, lr_ratio_first, lr_ratio_last);
 
-        // Determine the difference between the first and last ratios
+        // Determine the difference between the first and last ratios,
+        // first and last are tracked over the whole gesture
         ud_delta = ud_ratio_last - ud_ratio_first;
         lr_delta = lr_ratio_last - lr_ratio_first;
 
-        DEBUG("Deltas: UD:%d LR:%d", __FUNCTION__, ud_delta, lr_delta);
+        // Movement since previous processing step, zero for a still hand
+        ud_step = ud_ratio_last - p_gdata->ud_ratio_prev;
+        lr_step = lr_ratio_last - p_gdata->lr_ratio_prev;
+        p_gdata->ud_ratio_prev = ud_ratio_last;
+        p_gdata->lr_ratio_prev = lr_ratio_last;
 
-        // Accumulate the UD and LR delta values
-        p_gdelta->ud += ud_delta;
-        p_gdelta->lr += lr_delta;
+        DEBUG("Deltas: UD:%d LR:%d Steps: UD:%d LR:%d", __FUNCTION__,
+            ud_delta, lr_delta, ud_step, lr_step);
 
-        DEBUG("Accu: UD:%d LR:%d", __FUNCTION__, p_gdelta->ud, p_gdelta->lr);
+        p_gdelta->ud = ud_delta;
+        p_gdelta->lr = lr_delta;
 
         // Determine UD gesture
-        if (p_gdelta->ud >= GESTURE_SENS_1)
+        if (p_gdelta->ud >= p_params->sens_1)
         {
             p_gcount->ud = 1;
         }
-        else if (p_gdelta->ud <= -GESTURE_SENS_1)
+        else if (p_gdelta->ud <= -p_params->sens_1)
         {
             p_gcount->ud = -1;
         }
@@ -448,11 +707,11 @@ gesture_process_data(apds9960_t *p_apds)
         }
 
         // Determine LR gesture
-        if (p_gdelta->lr >= GESTURE_SENS_1)
+        if (p_gdelta->lr >= p_params->sens_1)
         {
             p_gcount->lr = 1;
         }
-        else if (p_gdelta->lr <= -GESTURE_SENS_1)
+        else if (p_gdelta->lr <= -p_params->sens_1)
         {
             p_gcount->lr = -1;
         }
@@ -463,12 +722,12 @@ gesture_process_data(apds9960_t *p_apds)
 
 
         // Determine Near-Far gesture
-        if ((abs(ud_delta) < GESTURE_SENS_2) &&
-            (abs(lr_delta) < GESTURE_SENS_2))
+        if ((abs(ud_step) < p_params->sens_2) &&
+            (abs(lr_step) < p_params->sens_2))
         {
             if ((p_gcount->ud == 0) && (p_gcount->lr == 0))
             {
-                if ((ud_delta == 0) && (lr_delta == 0))
+                if ((ud_step == 0) && (lr_step == 0))
                 {
                     p_gcount->near++;
                 }
@@ -477,31 +736,34 @@ gesture_process_data(apds9960_t *p_apds)
                     p_gcount->far++;
                 }
 
-                if ((p_gcount->near >= 10) && (p_gcount->far >= 2))
+                if ((p_gcount->near >= p_params->near_count) &&
+                    (p_gcount->far >= p_params->far_count))
                 {
-                    if ((ud_delta == 0) && (lr_delta == 0))
+                    if ((ud_step == 0) && (lr_step == 0))
                     {
-                        p_apds->gesture_state = GESTURE_STATE_NEAR;
+                        p_dec->state = GESTURE_STATE_NEAR;
                     }
-                    else if ((ud_delta != 0) && (lr_delta != 0))
+                    else if ((ud_step != 0) && (lr_step != 0))
                     {
-                        p_apds->gesture_state = GESTURE_STATE_FAR;
+                        p_dec->state = GESTURE_STATE_FAR;
                     }
                 }
             }
             else
             {
-                if ((ud_delta == 0) && (lr_delta == 0))
+                if ((ud_step == 0) && (lr_step == 0))
                 {
                     p_gcount->near++;
                 }
 
-                if (p_gcount->near >= 10)
+                if (p_gcount->near >= p_params->near_count)
                 {
+                    // Hand is hovering, restart direction reference
                     p_gcount->ud = 0;
                     p_gcount->lr = 0;
                     p_gdelta->ud = 0;
                     p_gdelta->lr = 0;
+                    memcpy(p_gdata->first, p_gdata->last, 4);
                 }
             }
         }
@@ -518,19 +780,154 @@ gesture_process_data(apds9960_t *p_apds)
     return b_is_all_ok;
 }
 
+static void
+gesture_event_push(apds9960_t *p_apds, int gesture, uint32_t dset_count,
+    const struct timespec *p_now)
+{
+    apds9960_gesture_events_t *p_ring = &p_apds->gesture_events;
+    apds9960_gesture_event_t *p_event;
+
+    // Full ring: overwrite oldest event
+    if (p_ring->count == APDS9960_GESTURE_EVENTS_MAX)
+    {
+        p_ring->head = (uint8_t)((p_ring->head + 1) % APDS9960_GESTURE_EVENTS_MAX);
+        p_ring->count--;
+        p_ring->dropped++;
+    }
+
+    p_event = &p_ring->events[(p_ring->head + p_ring->count) %
+        APDS9960_GESTURE_EVENTS_MAX];
+    p_event->gesture = gesture;
+    p_event->timestamp = *p_now;
+    p_event->dset_count = dset_count;
+    p_event->duration_ms = (uint32_t)(timespec_diff_ns(p_now,
+        &p_apds->gesture_start) / 1000000);
+    p_ring->count++;
+
+    p_apds->gesture_last_event = gesture;
+}
+
+static bool
+gesture_fifo_drain(apds9960_t *p_apds, uint8_t *p_buffer, uint8_t *p_level,
+    apds9960_gstatus_t *p_gstatus)
+{
+    // GFLVL and GSTATUS are adjacent, read both in one transaction
+    uint8_t status[APDS9960_GSTATUS - APDS9960_GFLVL + 1];
+    bool b_is_all_ok = (reg_read(p_apds, APDS9960_GFLVL, status,
+        sizeof(status)) != -1);
+
+    *p_level = 0;
+
+    if (b_is_all_ok)
+    {
+        uint8_t level = status[0];
+
+        p_gstatus->byte = status[1];
+        if (level > GESTURE_FIFO_SIZE / 4)
+        {
+            level = GESTURE_FIFO_SIZE / 4;
+        }
+
+        // Pull all available datasets in as few bursts as possible
+        if (p_gstatus->GVALID && (level > 0))
+        {
+            b_is_all_ok = gesture_fifo_read(p_apds, p_buffer,
+                (uint32_t)level * 4, p_apds->gesture_fifo_chunk);
+            if (b_is_all_ok)
+            {
+                *p_level = level;
+            }
+        }
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+gesture_fifo_check_chunk(apds9960_t *p_apds, uint8_t chunk_size,
+    bool *p_is_passed)
+{
+    uint8_t ref_buffer[GESTURE_FIFO_SIZE];
+    uint8_t test_buffer[GESTURE_FIFO_SIZE];
+    uint8_t level_before = 0;
+    uint8_t level_after = 0;
+    uint8_t datasets = (uint8_t)(chunk_size / 4);
+    int ref_sum[4] = { 0 };
+    int test_sum[4] = { 0 };
+    bool b_is_filled = false;
+    bool b_is_all_ok;
+
+    *p_is_passed = false;
+
+    // Reference datasets read one at a time. FIFO not filling in time fails
+    // this chunk size only.
+    b_is_all_ok = gesture_fifo_wait_level(p_apds, datasets, &b_is_filled);
+    if (b_is_all_ok && b_is_filled)
+    {
+        b_is_all_ok = gesture_fifo_read(p_apds, ref_buffer, chunk_size, 4);
+    }
+
+    // Same amount of data read in a single burst
+    if (b_is_all_ok && b_is_filled)
+    {
+        b_is_all_ok = gesture_fifo_wait_level(p_apds, datasets, &b_is_filled);
+    }
+
+    if (b_is_all_ok && b_is_filled)
+    {
+        b_is_all_ok = reg_read8(p_apds, APDS9960_GFLVL, &level_before);
+    }
+
+    if (b_is_all_ok && b_is_filled)
+    {
+        b_is_all_ok = gesture_fifo_read(p_apds, test_buffer, chunk_size,
+            chunk_size);
+    }
+
+    if (b_is_all_ok && b_is_filled)
+    {
+        b_is_all_ok = reg_read8(p_apds, APDS9960_GFLVL, &level_after);
+    }
+
+    if (b_is_all_ok && b_is_filled)
+    {
+        for (int idx = 0; idx < chunk_size; idx++)
+        {
+            ref_sum[idx % 4] += ref_buffer[idx];
+            test_sum[idx % 4] += test_buffer[idx];
+        }
+
+        // Burst must pop exactly the datasets it returned (new datasets may
+        // arrive meanwhile) and carry the same U/D/L/R levels as the
+        // reference. Lost or misaligned bytes show up in one or the other.
+        *p_is_passed = ((int)level_after <= (int)level_before - datasets + 1) &&
+            ((int)level_after >= (int)level_before - datasets);
+
+        for (int ch = 0; ch < 4; ch++)
+        {
+            if (abs(ref_sum[ch] - test_sum[ch]) > SELFTEST_TOLERANCE * datasets)
+            {
+                *p_is_passed = false;
+            }
+        }
+    }
+
+    return b_is_all_ok;
+}
+
 static bool
-gesture_decode(apds9960_t *p_apds)
+gesture_decode(apds9960_gesture_decoder_t *p_dec)
 {
     bool b_is_decoded = false;
 
-    if (p_apds->gesture_state == GESTURE_STATE_NEAR)
+    if (p_dec->state == GESTURE_STATE_NEAR)
     {
-        p_apds->gesture_motion = GESTURE_DIR_NEAR;
+        p_dec->motion = GESTURE_DIR_NEAR;
         b_is_decoded = true;
     }
-    else if (p_apds->gesture_state == GESTURE_STATE_FAR)
+    else if (p_dec->state == GESTURE_STATE_FAR)
     {
-        p_apds->gesture_motion = GESTURE_DIR_FAR;
+        p_dec->motion = GESTURE_DIR_FAR;
         b_is_decoded = true;
     }
 
@@ -538,72 +935,72 @@ gesture_decode(apds9960_t *p_apds)
     {
         b_is_decoded = true;
 
-        if ((p_apds->gesture_count.ud == -1) && 
-            (p_apds->gesture_count.lr == 0))
+        if ((p_dec->count.ud == -1) && 
+            (p_dec->count.lr == 0))
         {
-            p_apds->gesture_motion = GESTURE_DIR_UP;
+            p_dec->motion = GESTURE_DIR_UP;
         }
-        else if ((p_apds->gesture_count.ud == 1) &&
-            (p_apds->gesture_count.lr == 0))
+        else if ((p_dec->count.ud == 1) &&
+            (p_dec->count.lr == 0))
         {
-            p_apds->gesture_motion = GESTURE_DIR_DOWN;
+            p_dec->motion = GESTURE_DIR_DOWN;
         }
-        else if ((p_apds->gesture_count.ud == 0) &&
-            (p_apds->gesture_count.lr == 1))
+        else if ((p_dec->count.ud == 0) &&
+            (p_dec->count.lr == 1))
         {
-            p_apds->gesture_motion = GESTURE_DIR_RIGHT;
+            p_dec->motion = GESTURE_DIR_RIGHT;
         }
-        else if ((p_apds->gesture_count.ud == 0) &&
-            (p_apds->gesture_count.lr == -1))
+        else if ((p_dec->count.ud == 0) &&
+            (p_dec->count.lr == -1))
         {
-            p_apds->gesture_motion = GESTURE_DIR_LEFT;
+            p_dec->motion = GESTURE_DIR_LEFT;
         }
-        else if ((p_apds->gesture_count.ud == -1) &&
-            (p_apds->gesture_count.lr == 1))
+        else if ((p_dec->count.ud == -1) &&
+            (p_dec->count.lr == 1))
         {
-            if (abs(p_apds->gesture_delta.ud) > abs(p_apds->gesture_delta.lr))
+            if (abs(p_dec->delta.ud) > abs(p_dec->delta.lr))
             {
-                p_apds->gesture_motion = GESTURE_DIR_UP;
+                p_dec->motion = GESTURE_DIR_UP;
             }
             else
             {
-                p_apds->gesture_motion = GESTURE_DIR_RIGHT;
+                p_dec->motion = GESTURE_DIR_RIGHT;
             }
         }
-        else if ((p_apds->gesture_count.ud == 1) &&
-            (p_apds->gesture_count.lr == -1))
+        else if ((p_dec->count.ud == 1) &&
+            (p_dec->count.lr == -1))
         {
-            if (abs(p_apds->gesture_delta.ud) > abs(p_apds->gesture_delta.lr))
+            if (abs(p_dec->delta.ud) > abs(p_dec->delta.lr))
             {
-                p_apds->gesture_motion = GESTURE_DIR_DOWN;
+                p_dec->motion = GESTURE_DIR_DOWN;
             }
             else
             {
-                p_apds->gesture_motion = GESTURE_DIR_LEFT;
+                p_dec->motion = GESTURE_DIR_LEFT;
             }
         }
-        else if ((p_apds->gesture_count.ud == -1) &&
-            (p_apds->gesture_count.lr == -1))
+        else if ((p_dec->count.ud == -1) &&
+            (p_dec->count.lr == -1))
         {
-            if (abs(p_apds->gesture_delta.ud) > abs(p_apds->gesture_delta.lr))
+            if (abs(p_dec->delta.ud) > abs(p_dec->delta.lr))
             {
-                p_apds->gesture_motion = GESTURE_DIR_UP;
+                p_dec->motion = GESTURE_DIR_UP;
             }
             else
             {
-                p_apds->gesture_motion = GESTURE_DIR_LEFT;
+                p_dec->motion = GESTURE_DIR_LEFT;
             }
         }
-        else if ((p_apds->gesture_count.ud == 1) &&
-            (p_apds->gesture_count.lr == 1))
+        else if ((p_dec->count.ud == 1) &&
+            (p_dec->count.lr == 1))
         {
-            if (abs(p_apds->gesture_delta.ud) > abs(p_apds->gesture_delta.lr))
+            if (abs(p_dec->delta.ud) > abs(p_dec->delta.lr))
             {
-                p_apds->gesture_motion = GESTURE_DIR_DOWN;
+                p_dec->motion = GESTURE_DIR_DOWN;
             }
             else
             {
-                p_apds->gesture_motion = GESTURE_DIR_RIGHT;
+                p_dec->motion = GESTURE_DIR_RIGHT;
             }
         }
         else
@@ -616,7 +1013,7 @@ gesture_decode(apds9960_t *p_apds)
     {
         char result[32];
 
-        switch (p_apds->gesture_motion)
+        switch (p_dec->motion)
         {
         case GESTURE_DIR_UP:
             strcpy(result, "Up");
@@ -0,0 +1,285 @@
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+// STATUS..PDATA, status and all sample data registers are contiguous
+#define SAMPLE_BLOCK_SIZE   (APDS9960_PDATA - APDS9960_STATUS + 1)
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+interrupt_clear(apds9960_t *p_apds, apds9960_status_t reg_status);
+
+/**
+ * @brief Wake device held asleep by SAI once hold time has passed.
+ *
+ * @param p_apds Device descriptor.
+ * @param p_deadline Set to wake time while still held, zeroed otherwise.
+ *
+ * @return True on success.
+ */
+static bool
+interrupt_sai_wake(apds9960_t *p_apds, struct timespec *p_deadline);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+void
+apds9960_set_callbacks(apds9960_t *p_apds,
+    const apds9960_callbacks_t *p_callbacks, void *p_ctx)
+{
+    if (p_callbacks)
+    {
+        p_apds->callbacks = *p_callbacks;
+    }
+    else
+    {
+        memset(&p_apds->callbacks, 0, sizeof(apds9960_callbacks_t));
+    }
+
+    p_apds->p_callbacks_ctx = p_ctx;
+}
+
+bool
+apds9960_read_all(apds9960_t *p_apds, apds9960_sample_t *p_sample)
+{
+    uint8_t block[SAMPLE_BLOCK_SIZE];
+
+    bool b_is_all_ok = (reg_read(p_apds, APDS9960_STATUS, block,
+        sizeof(block)) != -1);
+
+    if (b_is_all_ok)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &p_sample->timestamp);
+
+        p_sample->status.byte = block[0];
+        p_sample->rgbc.clear = (uint16_t)(block[1] | (block[2] << 8));
+        p_sample->rgbc.red = (uint16_t)(block[3] | (block[4] << 8));
+        p_sample->rgbc.green = (uint16_t)(block[5] | (block[6] << 8));
+        p_sample->rgbc.blue = (uint16_t)(block[7] | (block[8] << 8));
+        p_sample->proximity = block[APDS9960_PDATA - APDS9960_STATUS];
+
+        // Range of colour data, auto-ranging may change it for next samples
+        apds9960_control_t reg_control;
+        reg_control.byte = reg_shadow8(p_apds, APDS9960_CONTROL);
+        p_sample->als_gain = (uint8_t)(1 << (2 * reg_control.AGAIN));
+        p_sample->als_time_us = (uint32_t)(256 -
+            reg_shadow8(p_apds, APDS9960_ATIME)) * APDS9960_ALS_CYCLE_US;
+
+        b_is_all_ok = als_autorange_update(p_apds, p_sample);
+    }
+    else
+    {
+        memset(p_sample, 0, sizeof(apds9960_sample_t));
+        ERROR("Error reading sample.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+apds9960_service_interrupt(apds9960_t *p_apds,
+    struct timespec *p_next_deadline)
+{
+    apds9960_sample_t sample;
+    struct timespec deadline = { 0, 0 };
+    const apds9960_callbacks_t *p_cb = &p_apds->callbacks;
+    void *p_ctx = p_apds->p_callbacks_ctx;
+    int gesture;
+    int event;
+    bool b_is_held = false;
+    struct timespec rise_at;
+
+    apds9960_status_t reg_status;
+
+    // Sources of a device held asleep were serviced already
+    if (p_apds->sai.b_is_held)
+    {
+        bool b_is_all_ok = interrupt_sai_wake(p_apds, &deadline);
+
+        if (p_next_deadline)
+        {
+            *p_next_deadline = deadline;
+        }
+
+        return b_is_all_ok;
+    }
+
+    // One burst gives pending sources along with their data
+    bool b_is_all_ok = apds9960_read_all(p_apds, &sample);
+
+    reg_status = sample.status;
+
+    if (b_is_all_ok)
+    {
+        b_is_held = sai_sleep_begin(p_apds, reg_status, &sample.timestamp);
+    }
+
+    // Window must be moved before CICLEAR or the interrupt is raised again.
+    // Range changes invalidate it as well.
+    if (b_is_all_ok && (reg_status.AINT || p_apds->als_autorange.b_is_settling))
+    {
+        b_is_all_ok = als_wake_update(p_apds, &sample);
+    }
+
+    if (b_is_all_ok)
+    {
+        // AVALID is cleared for samples dropped by auto-ranging
+        if (reg_status.AINT && reg_status.AVALID)
+        {
+            // Sample also serves following apds9960_als_read_* calls
+            p_apds->als_sample = sample.rgbc;
+
+            if (p_cb->als)
+            {
+                p_cb->als(p_ctx, &sample);
+            }
+        }
+
+        if (reg_status.PINT && p_cb->proximity)
+        {
+            p_cb->proximity(p_ctx, sample.proximity);
+        }
+
+        // Band must be moved before PICLEAR, like the ALS window. Baseline
+        // rise is due at its deadline without interrupt.
+        if (reg_status.PINT || (presence_is_rise_pending(p_apds, &rise_at) &&
+            (timespec_diff_ns(&sample.timestamp, &rise_at) >= 0)))
+        {
+            event = presence_update(p_apds, sample.proximity,
+                &sample.timestamp);
+
+            if (event == -1)
+            {
+                b_is_all_ok = false;
+            }
+            else if ((event != PRESENCE_EVENT_NONE) && p_cb->presence)
+            {
+                p_cb->presence(p_ctx, event, sample.proximity);
+            }
+        }
+
+        if ((reg_status.CPSAT || reg_status.PGSAT) && p_cb->saturation)
+        {
+            p_cb->saturation(p_ctx, reg_status);
+        }
+
+        // Clear wakes a device sleeping after interrupt
+        if (b_is_held)
+        {
+            b_is_all_ok = interrupt_sai_wake(p_apds, &deadline) && b_is_all_ok;
+        }
+        else
+        {
+            b_is_all_ok = interrupt_clear(p_apds, reg_status) && b_is_all_ok;
+        }
+    }
+
+    // Gesture interrupt is cleared by draining FIFO, a gesture in progress
+    // is read at its deadline even without interrupt
+    if (b_is_all_ok && (reg_status.GINT || p_apds->b_is_gesture_active))
+    {
+        gesture = apds9960_gesture_poll(p_apds, NULL, &deadline);
+
+        if (gesture == -1)
+        {
+            b_is_all_ok = false;
+        }
+        else if ((gesture != GESTURE_DIR_NONE) && p_cb->gesture)
+        {
+            p_cb->gesture(p_ctx, gesture);
+        }
+    }
+
+    if (b_is_all_ok && !p_apds->sai.b_is_held)
+    {
+        sai_wake(p_apds);
+    }
+
+    if (presence_is_rise_pending(p_apds, &rise_at) &&
+        (timespec_is_zero(&deadline) ||
+        (timespec_diff_ns(&rise_at, &deadline) < 0)))
+    {
+        deadline = rise_at;
+    }
+
+    if (p_next_deadline)
+    {
+        *p_next_deadline = deadline;
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error servicing interrupt.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+interrupt_clear(apds9960_t *p_apds, apds9960_status_t reg_status)
+{
+    bool b_is_all_ok = true;
+
+    // CICLEAR clears AINT and CPSAT, PICLEAR clears PINT and PGSAT
+    bool b_is_als = reg_status.AINT || reg_status.CPSAT;
+    bool b_is_prox = reg_status.PINT || reg_status.PGSAT;
+
+    if (b_is_als && b_is_prox)
+    {
+        b_is_all_ok = reg_write_addr(p_apds, APDS9960_AICLEAR);
+    }
+    else if (b_is_als)
+    {
+        b_is_all_ok = reg_write_addr(p_apds, APDS9960_CICLEAR);
+    }
+    else if (b_is_prox)
+    {
+        b_is_all_ok = reg_write_addr(p_apds, APDS9960_PICLEAR);
+    }
+
+    // Next CPSAT is a new saturation for auto-ranging
+    if (b_is_all_ok && b_is_als)
+    {
+        p_apds->als_autorange.b_is_cpsat_seen = false;
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+interrupt_sai_wake(apds9960_t *p_apds, struct timespec *p_deadline)
+{
+    bool b_is_all_ok = true;
+
+    if (sai_is_wake_due(p_apds, p_deadline))
+    {
+        b_is_all_ok = interrupt_clear(p_apds, p_apds->sai.held_status);
+
+        if (b_is_all_ok)
+        {
+            sai_wake(p_apds);
+        }
+
+        p_deadline->tv_sec = 0;
+        p_deadline->tv_nsec = 0;
+    }
+
+    return b_is_all_ok;
+}
+
+/* [] END OF FILE */
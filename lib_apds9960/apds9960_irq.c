@@ -0,0 +1,162 @@
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_irq.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static int
+irq_poll_handle(apds9960_irq_t *p_irq);
+
+static bool
+irq_poll_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted);
+
+static void
+irq_poll_close(apds9960_irq_t *p_irq);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const apds9960_irq_ops_t IRQ_OPS_POLL = {
+    .name = "poll",
+    .handle = irq_poll_handle,
+    .is_asserted = irq_poll_is_asserted,
+    .close = irq_poll_close
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_irq_t
+*apds9960_irq_open_poll(apds9960_irq_level_t p_read_level, void *p_ctx,
+    uint32_t period_ms)
+{
+    struct itimerspec period;
+    apds9960_irq_t *p_irq = calloc(1, sizeof(apds9960_irq_t));
+
+    if (!p_irq)
+    {
+        ERROR("Not enough free memory.", __FUNCTION__);
+        return NULL;
+    }
+
+    if (period_ms == 0)
+    {
+        period_ms = APDS9960_IRQ_POLL_PERIOD_MS;
+    }
+
+    p_irq->p_ops = &IRQ_OPS_POLL;
+    p_irq->p_read_level = p_read_level;
+    p_irq->p_level_ctx = p_ctx;
+
+    period.it_interval.tv_sec = period_ms / 1000;
+    period.it_interval.tv_nsec = (long)(period_ms % 1000) * 1000000L;
+    period.it_value = period.it_interval;
+
+    p_irq->fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    if ((p_irq->fd == -1) || (timerfd_settime(p_irq->fd, 0, &period, NULL) != 0))
+    {
+        ERROR("Cannot create poll timer: %d.", __FUNCTION__, errno);
+        irq_poll_close(p_irq);
+        p_irq = NULL;
+    }
+
+    return p_irq;
+}
+
+void
+apds9960_irq_close(apds9960_irq_t *p_irq)
+{
+    if (p_irq)
+    {
+        p_irq->p_ops->close(p_irq);
+    }
+}
+
+int
+apds9960_irq_get_fd(const apds9960_irq_t *p_irq)
+{
+    return p_irq->fd;
+}
+
+int
+apds9960_irq_handle(apds9960_irq_t *p_irq)
+{
+    int result = p_irq->p_ops->handle(p_irq);
+
+    p_irq->wakeups++;
+    if (result == 1)
+    {
+        p_irq->interrupts++;
+    }
+
+    return result;
+}
+
+bool
+apds9960_irq_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted)
+{
+    return p_irq->p_ops->is_asserted(p_irq, p_is_asserted);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static int
+irq_poll_handle(apds9960_irq_t *p_irq)
+{
+    uint64_t expirations;
+    bool b_was_asserted = p_irq->b_is_asserted;
+
+    // Consume timer event
+    if (read(p_irq->fd, &expirations, sizeof(expirations)) == -1)
+    {
+        ERROR("Cannot read poll timer: %d.", __FUNCTION__, errno);
+        return -1;
+    }
+
+    if (!irq_poll_is_asserted(p_irq, &p_irq->b_is_asserted))
+    {
+        return -1;
+    }
+
+    // INT level is kept until serviced, report high to low transitions only
+    return (p_irq->b_is_asserted && !b_was_asserted) ? 1 : 0;
+}
+
+static bool
+irq_poll_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted)
+{
+    bool b_is_all_ok = p_irq->p_read_level(p_irq->p_level_ctx, p_is_asserted);
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Cannot read INT pin level.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+static void
+irq_poll_close(apds9960_irq_t *p_irq)
+{
+    if (p_irq->fd != -1)
+    {
+        close(p_irq->fd);
+    }
+
+    free(p_irq);
+}
+
+/* [] END OF FILE */
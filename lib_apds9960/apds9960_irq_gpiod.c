@@ -0,0 +1,152 @@
+
+#ifdef APDS9960_LINUX_HOST
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/gpio.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_irq.h"
+
+#define GPIOD_CONSUMER      "apds9960-int"
+#define GPIOD_EVENTS_MAX    16      // Edge events consumed per read
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static int
+irq_gpiod_handle(apds9960_irq_t *p_irq);
+
+static bool
+irq_gpiod_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted);
+
+static void
+irq_gpiod_close(apds9960_irq_t *p_irq);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const apds9960_irq_ops_t IRQ_OPS_GPIOD = {
+    .name = "gpiod",
+    .handle = irq_gpiod_handle,
+    .is_asserted = irq_gpiod_is_asserted,
+    .close = irq_gpiod_close
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_irq_t
+*apds9960_irq_open_gpiod(const char *p_chip_path, unsigned int line_offset)
+{
+    struct gpio_v2_line_request request;
+    apds9960_irq_t *p_irq = NULL;
+
+    int chip_fd = open(p_chip_path, O_RDWR | O_CLOEXEC);
+    if (chip_fd == -1)
+    {
+        ERROR("Cannot open %s: %d.", __FUNCTION__, p_chip_path, errno);
+        return NULL;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = line_offset;
+    request.num_lines = 1;
+    strncpy(request.consumer, GPIOD_CONSUMER, sizeof(request.consumer) - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT |
+        GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    // Line request fd delivers edge events and outlives the chip fd
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) == -1)
+    {
+        ERROR("Cannot request line %u of %s: %d.", __FUNCTION__, line_offset,
+            p_chip_path, errno);
+    }
+    else
+    {
+        p_irq = calloc(1, sizeof(apds9960_irq_t));
+        if (p_irq)
+        {
+            p_irq->p_ops = &IRQ_OPS_GPIOD;
+            p_irq->fd = request.fd;
+        }
+        else
+        {
+            ERROR("Not enough free memory.", __FUNCTION__);
+            close(request.fd);
+        }
+    }
+
+    close(chip_fd);
+
+    return p_irq;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static int
+irq_gpiod_handle(apds9960_irq_t *p_irq)
+{
+    struct gpio_v2_line_event events[GPIOD_EVENTS_MAX];
+
+    // Every event is a falling edge, edges queued meanwhile need one service
+    ssize_t result = read(p_irq->fd, events, sizeof(events));
+    if (result == -1)
+    {
+        if ((errno == EAGAIN) || (errno == EINTR))
+        {
+            return 0;
+        }
+
+        ERROR("Cannot read line events: %d.", __FUNCTION__, errno);
+        return -1;
+    }
+
+    return (result >= (ssize_t)sizeof(events[0])) ? 1 : 0;
+}
+
+static bool
+irq_gpiod_is_asserted(apds9960_irq_t *p_irq, bool *p_is_asserted)
+{
+    struct gpio_v2_line_values values;
+    bool b_is_all_ok = false;
+
+    values.bits = 0;
+    values.mask = 1;
+
+    if (ioctl(p_irq->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == -1)
+    {
+        ERROR("Cannot read line value: %d.", __FUNCTION__, errno);
+    }
+    else
+    {
+        // INT is active low
+        *p_is_asserted = ((values.bits & 1) == 0);
+        b_is_all_ok = true;
+    }
+
+    return b_is_all_ok;
+}
+
+static void
+irq_gpiod_close(apds9960_irq_t *p_irq)
+{
+    close(p_irq->fd);
+    free(p_irq);
+}
+
+#endif // APDS9960_LINUX_HOST
+
+/* [] END OF FILE */
@@ -0,0 +1,147 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_lux.h"
+
+// Open-air coefficients of APDS-9960
+#define LUX_GA_MILLI        1000
+#define LUX_DF              310
+#define LUX_R_COEF_MILLI    136
+#define LUX_G_COEF_MILLI    1000
+#define LUX_B_COEF_MILLI    (-444)
+#define LUX_CT_COEF         3810
+#define LUX_CT_OFFSET       1391
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static void
+lux_range_update(apds9960_lux_t *p_lux, uint8_t als_gain,
+    uint32_t als_time_us);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+void
+apds9960_lux_cal_default(apds9960_lux_cal_t *p_cal)
+{
+    p_cal->ga_milli = LUX_GA_MILLI;
+    p_cal->df = LUX_DF;
+    p_cal->r_coef_milli = LUX_R_COEF_MILLI;
+    p_cal->g_coef_milli = LUX_G_COEF_MILLI;
+    p_cal->b_coef_milli = LUX_B_COEF_MILLI;
+    p_cal->ct_coef = LUX_CT_COEF;
+    p_cal->ct_offset = LUX_CT_OFFSET;
+}
+
+void
+apds9960_lux_init(apds9960_lux_t *p_lux, const apds9960_lux_cal_t *p_cal)
+{
+    if (p_cal)
+    {
+        p_lux->cal = *p_cal;
+    }
+    else
+    {
+        apds9960_lux_cal_default(&p_lux->cal);
+    }
+
+    // Factor is computed with first sample
+    p_lux->als_gain = 0;
+    p_lux->als_time_us = 0;
+    p_lux->cpl_inv_q24 = 0;
+    p_lux->full_scale = 0;
+}
+
+bool
+apds9960_lux_compute(apds9960_lux_t *p_lux, const apds9960_rgbc_t *p_rgbc,
+    uint8_t als_gain, uint32_t als_time_us, apds9960_light_t *p_light)
+{
+    const apds9960_lux_cal_t *p_cal = &p_lux->cal;
+    int32_t ir;
+    int32_t red;
+    int32_t green;
+    int32_t blue;
+    int64_t weighted;
+    uint64_t lux_milli;
+
+    if ((als_gain != p_lux->als_gain) || (als_time_us != p_lux->als_time_us))
+    {
+        lux_range_update(p_lux, als_gain, als_time_us);
+    }
+
+    ir = ((int32_t)p_rgbc->red + p_rgbc->green + p_rgbc->blue -
+        p_rgbc->clear) / 2;
+    if (ir < 0)
+    {
+        ir = 0;
+    }
+
+    red = p_rgbc->red - ir;
+    green = p_rgbc->green - ir;
+    blue = p_rgbc->blue - ir;
+
+    // Weighted counts in 1/1000 units
+    weighted = (int64_t)p_cal->r_coef_milli * red +
+        (int64_t)p_cal->g_coef_milli * green +
+        (int64_t)p_cal->b_coef_milli * blue;
+
+    lux_milli = (weighted > 0) ?
+        ((uint64_t)weighted * p_lux->cpl_inv_q24) >> 24 : 0;
+
+    p_light->lux_milli = (lux_milli > UINT32_MAX) ? UINT32_MAX :
+        (uint32_t)lux_milli;
+    p_light->ir = (uint16_t)ir;
+    p_light->cct = 0;
+
+    if (red > 0)
+    {
+        int32_t cct = p_cal->ct_coef * blue / red + p_cal->ct_offset;
+
+        p_light->cct = (cct < 0) ? 0 : ((cct > 0xFFFF) ? 0xFFFF : (uint16_t)cct);
+    }
+
+    return (p_rgbc->clear < p_lux->full_scale);
+}
+
+bool
+apds9960_lux_from_sample(apds9960_lux_t *p_lux,
+    const apds9960_sample_t *p_sample, apds9960_light_t *p_light)
+{
+    return apds9960_lux_compute(p_lux, &p_sample->rgbc, p_sample->als_gain,
+        p_sample->als_time_us, p_light);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+lux_range_update(apds9960_lux_t *p_lux, uint8_t als_gain,
+    uint32_t als_time_us)
+{
+    const apds9960_lux_cal_t *p_cal = &p_lux->cal;
+    uint64_t divisor = (uint64_t)als_time_us * als_gain;
+    uint32_t full_scale = (als_time_us / APDS9960_ALS_CYCLE_US) *
+        APDS9960_ALS_CYCLE_COUNTS;
+
+    p_lux->als_gain = als_gain;
+    p_lux->als_time_us = als_time_us;
+
+    // lux_milli = weighted_milli * GA_milli * DF / (ATIME_us * AGAIN)
+    p_lux->cpl_inv_q24 = (divisor > 0) ?
+        (((uint64_t)p_cal->ga_milli * (uint64_t)p_cal->df) << 24) / divisor : 0;
+
+    p_lux->full_scale = (full_scale > 0xFFFF) ? 0xFFFF : (uint16_t)full_scale;
+}
+
+/* [] END OF FILE */
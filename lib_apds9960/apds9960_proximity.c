@@ -1,13 +1,27 @@
 
 #include <stdbool.h>
+#include <time.h>
 
 #include "lib_apds9960.h"
 #include "apds9960_common.h"
 
+#define PRESENCE_APPROACH_DELTA     40
+#define PRESENCE_LEAVE_DELTA        20
+#define PRESENCE_DRIFT_BAND         4
+#define PRESENCE_RISE_STEP          1       // Baseline rise per period
+#define PRESENCE_RISE_PERIOD_MS     1000    // Approaching target outruns it
+#define PRESENCE_PPERS              2
+#define PRESENCE_PPERS_MAX          15
+
 /*******************************************************************************
 * Forward declarations of private functions
 *******************************************************************************/
 
+static bool
+presence_band_set(apds9960_t *p_apds);
+
+static bool
+prox_window_set(apds9960_t *p_apds, uint8_t low, uint8_t high);
 
 /*******************************************************************************
 * Global variables
@@ -27,13 +41,10 @@ apds9960_proximity_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
     // -- PGAIN: init value
     // -- LDRIVE: init value
     apds9960_control_t reg_control;
-    b_is_all_ok = reg_read8(p_apds, APDS9960_CONTROL, &reg_control.byte);
-    if (b_is_all_ok)
-    {
-        reg_control.PGAIN = APDS_INIT_PGAIN;
-        reg_control.LDRIVE = APDS_INIT_LDRIVE;
-        b_is_all_ok = reg_write8(p_apds, APDS9960_CONTROL, &reg_control.byte);
-    }
+    reg_control.byte = reg_shadow8(p_apds, APDS9960_CONTROL);
+    reg_control.PGAIN = APDS_INIT_PGAIN;
+    reg_control.LDRIVE = APDS_INIT_LDRIVE;
+    b_is_all_ok = reg_write8(p_apds, APDS9960_CONTROL, &reg_control.byte);
 
     // Set ENABLE register
     // -- PON: Power On
@@ -42,14 +53,11 @@ apds9960_proximity_enable(apds9960_t *p_apds, bool b_is_interrupt_enabled)
     if (b_is_all_ok)
     {
         apds9960_enable_t reg_enable;
-        b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        if (b_is_all_ok)
-        {
-            reg_enable.PON = 1;
-            reg_enable.PEN = 1;
-            reg_enable.PIEN = b_is_interrupt_enabled;
-            b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-        }
+        reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+        reg_enable.PON = 1;
+        reg_enable.PEN = 1;
+        reg_enable.PIEN = b_is_interrupt_enabled;
+        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
     }
 
     if (!b_is_all_ok)
@@ -67,14 +75,11 @@ apds9960_proximity_disable(apds9960_t *p_apds)
     // -- PEN: Proximity Disable
     // -- PIEN: Proximity Interrupt Disable
     apds9960_enable_t reg_enable;
-    bool b_is_all_ok = reg_read8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    reg_enable.PEN = 0;
+    reg_enable.PIEN = 0;
 
-    if (b_is_all_ok)
-    {
-        reg_enable.PEN = 0;
-        reg_enable.PIEN = 0;
-        b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
-    }
+    bool b_is_all_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_enable.byte);
 
     if (!b_is_all_ok)
     {
@@ -91,10 +96,191 @@ apds9960_proximity_read(apds9960_t *p_apds, uint8_t *p_value_proximity)
     return reg_read8(p_apds, APDS9960_PDATA, p_value_proximity);
 }
 
+void
+apds9960_presence_params_default(apds9960_presence_params_t *p_params)
+{
+    p_params->approach_delta = PRESENCE_APPROACH_DELTA;
+    p_params->leave_delta = PRESENCE_LEAVE_DELTA;
+    p_params->drift_band = PRESENCE_DRIFT_BAND;
+    p_params->ppers = PRESENCE_PPERS;
+}
+
+bool
+apds9960_presence_enable(apds9960_t *p_apds,
+    const apds9960_presence_params_t *p_params)
+{
+    apds9960_presence_t *p_pr = &p_apds->presence;
+    bool b_is_all_ok = false;
+
+    if (p_params)
+    {
+        p_pr->params = *p_params;
+    }
+    else
+    {
+        apds9960_presence_params_default(&p_pr->params);
+    }
+
+    // Bands must nest: drift < leave < approach
+    if ((p_pr->params.drift_band == 0) ||
+        (p_pr->params.drift_band > p_pr->params.leave_delta) ||
+        (p_pr->params.leave_delta >= p_pr->params.approach_delta) ||
+        (p_pr->params.ppers > PRESENCE_PPERS_MAX))
+    {
+        ERROR("Invalid presence detection parameters.", __FUNCTION__);
+    }
+    else
+    {
+        p_pr->b_is_present = false;
+        p_pr->b_is_baseline_valid = false;
+        p_pr->b_is_rise_pending = false;
+        b_is_all_ok = true;
+
+        apds9960_pers_t reg_pers;
+        reg_pers.byte = reg_shadow8(p_apds, APDS9960_PERS);
+        if (reg_pers.PPERS != p_pr->params.ppers)
+        {
+            reg_pers.PPERS = p_pr->params.ppers;
+            b_is_all_ok = reg_write8(p_apds, APDS9960_PERS, &reg_pers.byte);
+        }
+
+        // Empty band, first cycle interrupts and gives baseline
+        b_is_all_ok = b_is_all_ok && prox_window_set(p_apds, 0xFF, 0) &&
+            apds9960_proximity_enable(p_apds, true);
+    }
+
+    p_pr->b_is_enabled = b_is_all_ok;
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_presence_disable(apds9960_t *p_apds)
+{
+    p_apds->presence.b_is_enabled = false;
+}
+
+int
+presence_update(apds9960_t *p_apds, uint8_t proximity,
+    const struct timespec *p_now)
+{
+    apds9960_presence_t *p_pr = &p_apds->presence;
+    int event = PRESENCE_EVENT_NONE;
+    bool b_is_rise_due = p_pr->b_is_rise_pending &&
+        (timespec_diff_ns(p_now, &p_pr->rise_at) >= 0);
+
+    if (!p_pr->b_is_enabled)
+    {
+        return PRESENCE_EVENT_NONE;
+    }
+
+    // Any outcome but waiting for the rise restores the drift band
+    if (b_is_rise_due ||
+        (proximity <= p_pr->baseline + p_pr->params.drift_band))
+    {
+        p_pr->b_is_rise_pending = false;
+    }
+
+    if (!p_pr->b_is_baseline_valid)
+    {
+        p_pr->baseline = proximity;
+        p_pr->b_is_baseline_valid = true;
+    }
+    else if (p_pr->b_is_present)
+    {
+        if (proximity < p_pr->baseline + p_pr->params.leave_delta)
+        {
+            p_pr->b_is_present = false;
+            event = PRESENCE_EVENT_LEAVE;
+
+            // Reading persisted below leave level is the floor now, takes
+            // in drift of either direction while target was present
+            p_pr->baseline = proximity;
+        }
+    }
+    else if (proximity >= p_pr->baseline + p_pr->params.approach_delta)
+    {
+        p_pr->b_is_present = true;
+        p_pr->b_is_rise_pending = false;
+        event = PRESENCE_EVENT_APPROACH;
+    }
+    else if (proximity > p_pr->baseline + p_pr->params.drift_band)
+    {
+        // Crosstalk growing with temperature or smudge, rate limited so
+        // that a target approaching or held near is not taken in. Band is
+        // opened up to approach meanwhile, the deadline follows the rise.
+        if (b_is_rise_due)
+        {
+            p_pr->baseline += PRESENCE_RISE_STEP;
+        }
+        else if (!p_pr->b_is_rise_pending)
+        {
+            p_pr->b_is_rise_pending = true;
+            p_pr->rise_at = *p_now;
+            timespec_add_ms(&p_pr->rise_at, PRESENCE_RISE_PERIOD_MS);
+        }
+    }
+    else if (proximity < p_pr->baseline)
+    {
+        // Floor dropped below drift band
+        p_pr->baseline = proximity;
+    }
+
+    if (!presence_band_set(p_apds))
+    {
+        ERROR("Error setting proximity threshold band.", __FUNCTION__);
+        event = -1;
+    }
+
+    return event;
+}
+
+bool
+presence_is_rise_pending(const apds9960_t *p_apds, struct timespec *p_rise_at)
+{
+    const apds9960_presence_t *p_pr = &p_apds->presence;
+
+    *p_rise_at = p_pr->rise_at;
+
+    return p_pr->b_is_enabled && p_pr->b_is_rise_pending;
+}
 
 /*******************************************************************************
 * Private function definitions
 *******************************************************************************/
 
+static bool
+presence_band_set(apds9960_t *p_apds)
+{
+    const apds9960_presence_t *p_pr = &p_apds->presence;
+    int low;
+    int high;
+
+    if (p_pr->b_is_present)
+    {
+        // Only leave is of interest, PIHT of 255 never interrupts
+        low = p_pr->baseline + p_pr->params.leave_delta;
+        high = 0xFF;
+    }
+    else
+    {
+        // Rise out of drift band interrupts once, readings short of
+        // approach do not wake host again until the baseline rise is due
+        low = p_pr->baseline - p_pr->params.drift_band;
+        high = p_pr->baseline + (p_pr->b_is_rise_pending ?
+            p_pr->params.approach_delta - 1 : p_pr->params.drift_band);
+    }
+
+    return prox_window_set(p_apds, (uint8_t)((low < 0) ? 0 : low),
+        (uint8_t)((high > 0xFF) ? 0xFF : high));
+}
+
+static bool
+prox_window_set(apds9960_t *p_apds, uint8_t low, uint8_t high)
+{
+    // PILT and PIHT are separated by a reserved register, written singly
+    return reg_update(p_apds, APDS9960_PILT, &low, 1) &&
+        reg_update(p_apds, APDS9960_PIHT, &high, 1);
+}
 
 /* [] END OF FILE */
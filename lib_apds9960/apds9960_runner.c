@@ -0,0 +1,514 @@
+#ifdef APDS9960_LINUX_HOST
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_irq.h"
+#include "apds9960_runner.h"
+
+#define RUNNER_CACHE_LINE       64
+#define RUNNER_CAPACITY_MAX     0x10000
+#define RUNNER_SERVICE_PASSES   4       // Services while INT stays asserted
+#define RUNNER_RETRY_MS         5       // Service retry, INT asserted or error
+
+// epoll event sources
+enum {
+    RUNNER_SRC_STOP,
+    RUNNER_SRC_IRQ,
+    RUNNER_SRC_TIMER,
+    RUNNER_SRC_ALL
+};
+
+struct apds9960_runner
+{
+    apds9960_t *p_apds;
+    apds9960_irq_t *p_irq;
+    apds9960_callbacks_t app_callbacks;     // Restored on stop
+    void *p_app_callbacks_ctx;
+    pthread_t thread;
+    int event_fd;                           // Items queued, to consumer
+    int stop_fd;                            // Stop request, to runner
+    int timer_fd;                           // Service and schedule deadlines
+    struct timespec service_deadline;       // From last service, 0 for none
+    int epoll_fd;
+    apds9960_runner_item_t *p_items;
+    uint32_t mask;                          // Capacity - 1
+    bool b_is_pushed;                       // Items pushed this round
+
+    // Producer and consumer indices on own cache lines, free running
+    _Alignas(RUNNER_CACHE_LINE) uint32_t head;
+    _Alignas(RUNNER_CACHE_LINE) uint32_t tail;
+    _Alignas(RUNNER_CACHE_LINE) uint32_t dropped;
+};
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Runner thread, waits on stop request, INT and deadline timer.
+ *
+ * @param p_arg Runner.
+ *
+ * @return NULL.
+ */
+static void
+*runner_thread(void *p_arg);
+
+/**
+ * @brief Service sensor, repeated while INT stays asserted, step mode
+ * scheduler and arm deadline timer with the earliest deadline.
+ *
+ * @param p_runner Runner.
+ * @param b_is_service Service sensor, only scheduler step when false.
+ */
+static void
+runner_service(apds9960_runner_t *p_runner, bool b_is_service);
+
+/**
+ * @brief Copy item into ring, drop it when ring is full.
+ *
+ * Called only from runner thread.
+ *
+ * @param p_runner Runner.
+ * @param p_item Item to queue.
+ */
+static void
+runner_push(apds9960_runner_t *p_runner, const apds9960_runner_item_t *p_item);
+
+static void
+runner_als(void *p_ctx, const apds9960_sample_t *p_sample);
+
+static void
+runner_proximity(void *p_ctx, uint8_t proximity);
+
+static void
+runner_presence(void *p_ctx, int event, uint8_t proximity);
+
+static void
+runner_gesture(void *p_ctx, int gesture);
+
+static bool
+runner_epoll_add(apds9960_runner_t *p_runner, int fd, uint32_t source);
+
+static void
+runner_free(apds9960_runner_t *p_runner);
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_runner_t
+*apds9960_runner_start(apds9960_t *p_apds, apds9960_irq_t *p_irq,
+    uint32_t capacity)
+{
+    apds9960_runner_t *p_runner = NULL;
+    apds9960_callbacks_t callbacks;
+    uint32_t size = 1;
+    bool b_is_all_ok = (p_apds != NULL) && (p_irq != NULL) &&
+        (capacity <= RUNNER_CAPACITY_MAX);
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Invalid runner parameters.", __FUNCTION__);
+        return NULL;
+    }
+
+    // Free running indices wrap correctly with power of two capacity
+    capacity = capacity ? capacity : APDS9960_RUNNER_CAPACITY;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    p_runner = aligned_alloc(RUNNER_CACHE_LINE, (sizeof(apds9960_runner_t) +
+        RUNNER_CACHE_LINE - 1) / RUNNER_CACHE_LINE * RUNNER_CACHE_LINE);
+    if (p_runner)
+    {
+        memset(p_runner, 0, sizeof(apds9960_runner_t));
+        p_runner->event_fd = -1;
+        p_runner->stop_fd = -1;
+        p_runner->timer_fd = -1;
+        p_runner->epoll_fd = -1;
+        p_runner->p_items = calloc(size, sizeof(apds9960_runner_item_t));
+    }
+
+    if (!p_runner || !p_runner->p_items)
+    {
+        ERROR("Not enough free memory.", __FUNCTION__);
+        runner_free(p_runner);
+        return NULL;
+    }
+
+    p_runner->p_apds = p_apds;
+    p_runner->p_irq = p_irq;
+    p_runner->mask = size - 1;
+
+    p_runner->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    p_runner->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    p_runner->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_NONBLOCK | TFD_CLOEXEC);
+    p_runner->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    b_is_all_ok = (p_runner->event_fd != -1) && (p_runner->stop_fd != -1) &&
+        (p_runner->timer_fd != -1) && (p_runner->epoll_fd != -1) &&
+        runner_epoll_add(p_runner, p_runner->stop_fd, RUNNER_SRC_STOP) &&
+        runner_epoll_add(p_runner, apds9960_irq_get_fd(p_irq),
+            RUNNER_SRC_IRQ) &&
+        runner_epoll_add(p_runner, p_runner->timer_fd, RUNNER_SRC_TIMER);
+
+    if (b_is_all_ok)
+    {
+        // Results are queued instead of calling the application
+        p_runner->app_callbacks = p_apds->callbacks;
+        p_runner->p_app_callbacks_ctx = p_apds->p_callbacks_ctx;
+
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.als = runner_als;
+        callbacks.proximity = runner_proximity;
+        callbacks.presence = runner_presence;
+        callbacks.gesture = runner_gesture;
+        apds9960_set_callbacks(p_apds, &callbacks, p_runner);
+
+        if (pthread_create(&p_runner->thread, NULL, runner_thread,
+            p_runner) != 0)
+        {
+            apds9960_set_callbacks(p_apds, &p_runner->app_callbacks,
+                p_runner->p_app_callbacks_ctx);
+            b_is_all_ok = false;
+        }
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Cannot start runner: %d.", __FUNCTION__, errno);
+        runner_free(p_runner);
+        p_runner = NULL;
+    }
+
+    return p_runner;
+}
+
+void
+apds9960_runner_stop(apds9960_runner_t *p_runner)
+{
+    uint64_t stop = 1;
+
+    if (!p_runner)
+    {
+        return;
+    }
+
+    if (write(p_runner->stop_fd, &stop, sizeof(stop)) != sizeof(stop))
+    {
+        ERROR("Error stopping runner: %d.", __FUNCTION__, errno);
+    }
+
+    pthread_join(p_runner->thread, NULL);
+
+    apds9960_set_callbacks(p_runner->p_apds, &p_runner->app_callbacks,
+        p_runner->p_app_callbacks_ctx);
+
+    runner_free(p_runner);
+}
+
+int
+apds9960_runner_get_fd(const apds9960_runner_t *p_runner)
+{
+    return p_runner->event_fd;
+}
+
+bool
+apds9960_runner_pop(apds9960_runner_t *p_runner,
+    apds9960_runner_item_t *p_item)
+{
+    uint64_t count;
+    uint32_t tail = __atomic_load_n(&p_runner->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&p_runner->head, __ATOMIC_ACQUIRE);
+
+    if (tail == head)
+    {
+        // Rearm descriptor, then look again: an item pushed before the read
+        // is seen now, one pushed after it signals the descriptor again
+        if (read(p_runner->event_fd, &count, sizeof(count)) == -1)
+        {
+            // EAGAIN, descriptor was not signalled
+        }
+
+        head = __atomic_load_n(&p_runner->head, __ATOMIC_ACQUIRE);
+        if (tail == head)
+        {
+            return false;
+        }
+    }
+
+    *p_item = p_runner->p_items[tail & p_runner->mask];
+    __atomic_store_n(&p_runner->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+uint32_t
+apds9960_runner_get_dropped(const apds9960_runner_t *p_runner)
+{
+    return __atomic_load_n(&p_runner->dropped, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+*runner_thread(void *p_arg)
+{
+    apds9960_runner_t *p_runner = (apds9960_runner_t *)p_arg;
+    struct epoll_event events[RUNNER_SRC_ALL];
+    struct timespec now;
+    uint64_t expirations;
+    bool b_is_running = true;
+
+    // Interrupt may be pending already, scheduler needs its first deadline
+    runner_service(p_runner, true);
+
+    while (b_is_running)
+    {
+        bool b_is_service = false;
+        int count = epoll_wait(p_runner->epoll_fd, events, RUNNER_SRC_ALL, -1);
+
+        if ((count == -1) && (errno != EINTR))
+        {
+            ERROR("Error waiting for events: %d.", __FUNCTION__, errno);
+            break;
+        }
+
+        for (int idx = 0; idx < count; idx++)
+        {
+            switch (events[idx].data.u32)
+            {
+                case RUNNER_SRC_STOP:
+                    b_is_running = false;
+                    break;
+
+                case RUNNER_SRC_IRQ:
+                    if (apds9960_irq_handle(p_runner->p_irq) == 1)
+                    {
+                        b_is_service = true;
+                    }
+                    break;
+
+                case RUNNER_SRC_TIMER:
+                    // Timer may have been armed for a scheduler deadline
+                    if ((read(p_runner->timer_fd, &expirations,
+                        sizeof(expirations)) == sizeof(expirations)) &&
+                        !timespec_is_zero(&p_runner->service_deadline))
+                    {
+                        clock_gettime(CLOCK_MONOTONIC, &now);
+                        b_is_service = b_is_service || (timespec_diff_ns(&now,
+                            &p_runner->service_deadline) >= 0);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if (b_is_running)
+        {
+            runner_service(p_runner, b_is_service);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+runner_service(apds9960_runner_t *p_runner, bool b_is_service)
+{
+    apds9960_t *p_apds = p_runner->p_apds;
+    struct itimerspec timer;
+    struct timespec deadline = p_runner->service_deadline;
+    struct timespec sched_deadline = { 0, 0 };
+    struct timespec retry;
+    bool b_is_asserted = b_is_service;
+    bool b_is_serviced = true;
+    uint64_t signal = 1;
+
+    // Edge sources miss an interrupt raised again while servicing
+    for (int pass = 0; b_is_asserted && (pass < RUNNER_SERVICE_PASSES); pass++)
+    {
+        b_is_serviced = apds9960_service_interrupt(p_apds, &deadline);
+        p_runner->service_deadline = deadline;
+
+        // INT of a device held asleep stays asserted until its deadline
+        if (!b_is_serviced || p_apds->sai.b_is_held ||
+            !apds9960_irq_is_asserted(p_runner->p_irq, &b_is_asserted))
+        {
+            b_is_asserted = false;
+        }
+    }
+
+    // No new edge comes while INT stays asserted, retry from the timer
+    if (!b_is_serviced || b_is_asserted)
+    {
+        if (!b_is_serviced)
+        {
+            ERROR("Service failed, retrying.", __FUNCTION__);
+        }
+        else
+        {
+            ERROR("INT still asserted, retrying.", __FUNCTION__);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &retry);
+        timespec_add_ms(&retry, RUNNER_RETRY_MS);
+
+        if (timespec_is_zero(&deadline) ||
+            (timespec_diff_ns(&retry, &deadline) < 0))
+        {
+            deadline = retry;
+        }
+        p_runner->service_deadline = deadline;
+    }
+
+    apds9960_schedule_step(p_apds, NULL, &sched_deadline);
+
+    if (timespec_is_zero(&deadline) || (!timespec_is_zero(&sched_deadline) &&
+        (timespec_diff_ns(&sched_deadline, &deadline) < 0)))
+    {
+        deadline = sched_deadline;
+    }
+
+    // Absolute deadline, zero disarms
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value = deadline;
+    timerfd_settime(p_runner->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+
+    if (p_runner->b_is_pushed)
+    {
+        p_runner->b_is_pushed = false;
+
+        if (write(p_runner->event_fd, &signal, sizeof(signal)) == -1)
+        {
+            ERROR("Error signalling consumer: %d.", __FUNCTION__, errno);
+        }
+    }
+}
+
+static void
+runner_push(apds9960_runner_t *p_runner, const apds9960_runner_item_t *p_item)
+{
+    uint32_t head = __atomic_load_n(&p_runner->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&p_runner->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail > p_runner->mask)
+    {
+        // Acquisition never waits for the consumer
+        __atomic_fetch_add(&p_runner->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    p_runner->p_items[head & p_runner->mask] = *p_item;
+    __atomic_store_n(&p_runner->head, head + 1, __ATOMIC_RELEASE);
+    p_runner->b_is_pushed = true;
+}
+
+static void
+runner_als(void *p_ctx, const apds9960_sample_t *p_sample)
+{
+    apds9960_runner_item_t item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = RUNNER_ITEM_ALS;
+    item.sample = *p_sample;
+
+    runner_push((apds9960_runner_t *)p_ctx, &item);
+}
+
+static void
+runner_proximity(void *p_ctx, uint8_t proximity)
+{
+    apds9960_runner_item_t item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = RUNNER_ITEM_PROXIMITY;
+    item.sample.proximity = proximity;
+    clock_gettime(CLOCK_MONOTONIC, &item.sample.timestamp);
+
+    runner_push((apds9960_runner_t *)p_ctx, &item);
+}
+
+static void
+runner_presence(void *p_ctx, int event, uint8_t proximity)
+{
+    apds9960_runner_item_t item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = RUNNER_ITEM_PRESENCE;
+    item.event = event;
+    item.sample.proximity = proximity;
+    clock_gettime(CLOCK_MONOTONIC, &item.sample.timestamp);
+
+    runner_push((apds9960_runner_t *)p_ctx, &item);
+}
+
+static void
+runner_gesture(void *p_ctx, int gesture)
+{
+    apds9960_runner_item_t item;
+
+    memset(&item, 0, sizeof(item));
+    item.type = RUNNER_ITEM_GESTURE;
+    item.event = gesture;
+    clock_gettime(CLOCK_MONOTONIC, &item.sample.timestamp);
+
+    runner_push((apds9960_runner_t *)p_ctx, &item);
+}
+
+static bool
+runner_epoll_add(apds9960_runner_t *p_runner, int fd, uint32_t source)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = source;
+
+    return (epoll_ctl(p_runner->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+}
+
+static void
+runner_free(apds9960_runner_t *p_runner)
+{
+    if (!p_runner)
+    {
+        return;
+    }
+
+    int fds[] = { p_runner->epoll_fd, p_runner->timer_fd, p_runner->stop_fd,
+        p_runner->event_fd };
+
+    for (size_t idx = 0; idx < sizeof(fds) / sizeof(fds[0]); idx++)
+    {
+        if (fds[idx] != -1)
+        {
+            close(fds[idx]);
+        }
+    }
+
+    free(p_runner->p_items);
+    free(p_runner);
+}
+
+#endif // APDS9960_LINUX_HOST
+
+/* [] END OF FILE */
@@ -0,0 +1,205 @@
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+// ENABLE interrupt enable bits
+#define SAI_ENABLE_INT_MASK     0x30    // AIEN, PIEN
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Check whether STATUS flags drive INT with current enables.
+ *
+ * @param p_apds Device descriptor.
+ * @param reg_status STATUS register read by service.
+ *
+ * @return True when INT is asserted and the device sleeps.
+ */
+static bool
+sai_is_int_asserted(const apds9960_t *p_apds, apds9960_status_t reg_status);
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+bool
+apds9960_sai_enable(apds9960_t *p_apds, uint32_t hold_ms)
+{
+    apds9960_sai_t *p_sai = &p_apds->sai;
+    bool b_is_all_ok = true;
+
+    apds9960_enable_t reg_enable;
+    apds9960_config3_t reg_config3;
+    apds9960_gconf4_t reg_gconf4;
+
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+
+    if (!p_sai->b_is_enabled)
+    {
+        // Interrupt enables of the application, restored on disable
+        p_sai->enable_int = reg_enable.byte & SAI_ENABLE_INT_MASK;
+        p_sai->b_is_gien = reg_gconf4.GIEN;
+    }
+
+    // Every running engine must be able to end the cycle with an interrupt,
+    // the device would run on without sleeping otherwise
+    reg_enable.AIEN |= reg_enable.AEN;
+    reg_enable.PIEN |= reg_enable.PEN;
+    reg_gconf4.GIEN |= reg_enable.GEN;
+    reg_gconf4.GMODE = 0;
+
+    reg_config3.byte = reg_shadow8(p_apds, APDS9960_CONFIG3);
+    reg_config3.SAI = 1;
+
+    b_is_all_ok = reg_update(p_apds, APDS9960_CONFIG3, &reg_config3.byte, 1) &&
+        reg_update(p_apds, APDS9960_GCONF4, &reg_gconf4.byte, 1) &&
+        reg_update(p_apds, APDS9960_ENABLE, &reg_enable.byte, 1);
+
+    if (b_is_all_ok)
+    {
+        p_sai->b_is_enabled = true;
+        p_sai->hold_ms = hold_ms;
+        clock_gettime(CLOCK_MONOTONIC, &p_sai->wake);
+    }
+    else
+    {
+        ERROR("Error enabling sleep after interrupt.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+apds9960_sai_disable(apds9960_t *p_apds)
+{
+    apds9960_sai_t *p_sai = &p_apds->sai;
+    bool b_is_all_ok = true;
+
+    apds9960_enable_t reg_enable;
+    apds9960_config3_t reg_config3;
+    apds9960_gconf4_t reg_gconf4;
+
+    if (!p_sai->b_is_enabled)
+    {
+        return true;
+    }
+
+    // Device running again needs no clear, INT stays for the next service
+    reg_config3.byte = reg_shadow8(p_apds, APDS9960_CONFIG3);
+    reg_config3.SAI = 0;
+
+    reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+    reg_gconf4.GIEN = p_sai->b_is_gien;
+    reg_gconf4.GMODE = 0;
+
+    reg_enable.byte = (uint8_t)((reg_shadow8(p_apds, APDS9960_ENABLE) &
+        ~SAI_ENABLE_INT_MASK) | p_sai->enable_int);
+
+    b_is_all_ok = reg_update(p_apds, APDS9960_CONFIG3, &reg_config3.byte, 1) &&
+        reg_update(p_apds, APDS9960_GCONF4, &reg_gconf4.byte, 1) &&
+        reg_update(p_apds, APDS9960_ENABLE, &reg_enable.byte, 1);
+
+    if (p_sai->b_is_asleep)
+    {
+        sai_wake(p_apds);
+    }
+
+    p_sai->b_is_enabled = false;
+    p_sai->b_is_held = false;
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error disabling sleep after interrupt.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+sai_sleep_begin(apds9960_t *p_apds, apds9960_status_t reg_status,
+    const struct timespec *p_now)
+{
+    apds9960_sai_t *p_sai = &p_apds->sai;
+
+    if (!p_sai->b_is_enabled || p_sai->b_is_asleep ||
+        !sai_is_int_asserted(p_apds, reg_status))
+    {
+        return false;
+    }
+
+    // Device went to sleep when INT asserted, service is the first time
+    // the host can tell. Host latency counts as awake time.
+    p_sai->awake_us += (uint64_t)(timespec_diff_ns(p_now, &p_sai->wake) / 1000);
+    p_sai->sleep_start = *p_now;
+    p_sai->b_is_asleep = true;
+
+    // FIFO must be drained while a gesture is collected, no holding then
+    p_sai->b_is_held = (p_sai->hold_ms > 0) && !reg_status.GINT &&
+        !p_apds->b_is_gesture_active;
+    p_sai->held_status = reg_status;
+
+    return p_sai->b_is_held;
+}
+
+bool
+sai_is_wake_due(apds9960_t *p_apds, struct timespec *p_wake_at)
+{
+    apds9960_sai_t *p_sai = &p_apds->sai;
+    struct timespec now;
+
+    *p_wake_at = p_sai->sleep_start;
+    timespec_add_ms(p_wake_at, p_sai->hold_ms);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (timespec_diff_ns(&now, p_wake_at) >= 0);
+}
+
+void
+sai_wake(apds9960_t *p_apds)
+{
+    apds9960_sai_t *p_sai = &p_apds->sai;
+
+    if (!p_sai->b_is_asleep)
+    {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &p_sai->wake);
+    p_sai->asleep_us += (uint64_t)(timespec_diff_ns(&p_sai->wake,
+        &p_sai->sleep_start) / 1000);
+    p_sai->sleeps++;
+    p_sai->b_is_asleep = false;
+    p_sai->b_is_held = false;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+sai_is_int_asserted(const apds9960_t *p_apds, apds9960_status_t reg_status)
+{
+    apds9960_enable_t reg_enable;
+    apds9960_config2_t reg_config2;
+    apds9960_gconf4_t reg_gconf4;
+
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE);
+    reg_config2.byte = reg_shadow8(p_apds, APDS9960_CONFIG2);
+    reg_gconf4.byte = reg_shadow8(p_apds, APDS9960_GCONF4);
+
+    return (reg_status.AINT && reg_enable.AIEN) ||
+        (reg_status.PINT && reg_enable.PIEN) ||
+        (reg_status.GINT && reg_gconf4.GIEN) ||
+        (reg_status.CPSAT && reg_config2.CPSIEN) ||
+        (reg_status.PGSAT && reg_config2.PSIEN);
+}
+
+/* [] END OF FILE */
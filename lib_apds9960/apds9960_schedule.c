@@ -0,0 +1,377 @@
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+#define SCHED_STEP_US           APDS9960_ALS_CYCLE_US  // ATIME/WTIME step
+#define SCHED_WLONG_FACTOR      12
+#define SCHED_PULSE_BASE_US     700     // Fixed part of prox/gesture cycle
+#define SCHED_ENTRY_MHZ         20000   // Gesture entry check rate
+
+// Millihertz to period in microseconds and back
+#define SCHED_INVERSE(x)        ((uint32_t)(1000000000ull / (x)))
+
+// ENABLE bits kept from current value across phases
+#define SCHED_ENABLE_INT_MASK   0x30    // AIEN, PIEN
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Plan wait time not exceeding wait_us.
+ *
+ * Rounding down keeps achieved rates at or above requested ones.
+ *
+ * @param wait_us Wait wanted.
+ * @param p_wtime WTIME register value.
+ * @param p_is_wlong WLONG needed.
+ *
+ * @return Planned wait in microseconds, 0 when WEN should stay off.
+ */
+static uint32_t
+sched_wait_plan(uint32_t wait_us, uint8_t *p_wtime, bool *p_is_wlong);
+
+static uint8_t
+sched_gwtime_plan(uint32_t gesture_mhz, uint8_t gpulse, uint32_t *p_dset_us);
+
+static uint32_t
+sched_pulse_us(uint8_t pulse_reg, uint8_t diodes);
+
+static uint32_t
+sched_als_phase_us(const apds9960_t *p_apds);
+
+static bool
+sched_enable_write(apds9960_t *p_apds, uint8_t phase);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const uint32_t GWTIME_US[8] = {
+    0, 2800, 5600, 8400, 14000, 22400, 30800, 39200
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+bool
+apds9960_schedule_set(apds9960_t *p_apds, const apds9960_rates_t *p_rates,
+    apds9960_rates_t *p_achieved)
+{
+    apds9960_schedule_t *p_sched = &p_apds->schedule;
+    uint32_t prox_mhz = p_rates->prox_mhz;
+    uint32_t prox_us = 0;
+    uint32_t als_us = 0;
+    uint32_t wait_us = 0;
+    uint8_t reg_wtime = reg_shadow8(p_apds, APDS9960_WTIME);
+    bool b_is_wlong = false;
+    bool b_is_all_ok = true;
+
+    apds9960_enable_t reg_enable;
+    apds9960_config1_t reg_config1;
+    apds9960_config2_t reg_config2;
+    apds9960_config2_t reg_config2_init;
+    apds9960_gconf2_t reg_gconf2;
+    uint8_t reg_ppulse;
+
+    memset(p_sched, 0, sizeof(apds9960_schedule_t));
+    p_sched->requested = *p_rates;
+
+    // Gesture engine is entered from proximity cycles
+    if (p_rates->gesture_mhz && (prox_mhz < SCHED_ENTRY_MHZ))
+    {
+        prox_mhz = SCHED_ENTRY_MHZ;
+    }
+
+    reg_enable.byte = reg_shadow8(p_apds, APDS9960_ENABLE) &
+        SCHED_ENABLE_INT_MASK;
+    reg_enable.PON = (p_rates->als_mhz || prox_mhz) ? 1 : 0;
+    reg_enable.AEN = p_rates->als_mhz ? 1 : 0;
+    reg_enable.PEN = prox_mhz ? 1 : 0;
+    reg_enable.GEN = p_rates->gesture_mhz ? 1 : 0;
+
+    // Entry detection shares PPULSE and LED boost with proximity
+    reg_ppulse = p_rates->gesture_mhz ? APDS_INIT_PPULSE_GEST :
+        APDS_INIT_PPULSE_PROX;
+    reg_config2_init.byte = APDS_INIT_CONFIG2;
+    reg_config2.byte = reg_shadow8(p_apds, APDS9960_CONFIG2);
+    reg_config2.LED_BOOST = p_rates->gesture_mhz ? CONFIG2_LED_BOOST_300 :
+        reg_config2_init.LED_BOOST;
+
+    if (reg_enable.PEN)
+    {
+        prox_us = sched_pulse_us(reg_ppulse, 2);
+        p_sched->pulse_us = prox_us;
+    }
+
+    if (reg_enable.AEN)
+    {
+        als_us = (uint32_t)(256 - reg_shadow8(p_apds, APDS9960_ATIME)) *
+            SCHED_STEP_US;
+    }
+
+    if (!reg_enable.PON)
+    {
+        // Nothing requested, engines stay off
+    }
+    else if (!reg_enable.AEN || !reg_enable.PEN ||
+        (prox_mhz <= p_rates->als_mhz) ||
+        (SCHED_INVERSE(prox_mhz) >= prox_us + als_us))
+    {
+        // Single phase, every cycle serves all functions at fastest rate
+        uint32_t fastest = (prox_mhz > p_rates->als_mhz) ? prox_mhz :
+            p_rates->als_mhz;
+        uint32_t period_us = SCHED_INVERSE(fastest);
+
+        if (period_us > prox_us + als_us)
+        {
+            wait_us = sched_wait_plan(period_us - prox_us - als_us,
+                &reg_wtime, &b_is_wlong);
+        }
+
+        reg_enable.WEN = wait_us ? 1 : 0;
+        p_sched->period_us = prox_us + als_us + wait_us;
+        p_sched->phase_enable[SCHED_PHASE_ALS] = reg_enable.byte;
+
+        p_sched->achieved.als_mhz = reg_enable.AEN ?
+            SCHED_INVERSE(p_sched->period_us) : 0;
+        p_sched->achieved.prox_mhz = reg_enable.PEN ?
+            SCHED_INVERSE(p_sched->period_us) : 0;
+    }
+    else
+    {
+        // ALS integration would hold proximity back, enable ALS for one
+        // cycle per ALS period. Wait stays on in both phases, the cycle
+        // after the ALS one then starts when the phase has already ended.
+        if (SCHED_INVERSE(prox_mhz) > prox_us)
+        {
+            wait_us = sched_wait_plan(SCHED_INVERSE(prox_mhz) - prox_us,
+                &reg_wtime, &b_is_wlong);
+        }
+
+        p_sched->prox_cycle_us = prox_us + wait_us;
+        p_sched->b_is_multiplexed = true;
+
+        reg_enable.WEN = wait_us ? 1 : 0;
+        p_sched->phase_enable[SCHED_PHASE_ALS] = reg_enable.byte;
+
+        reg_enable.AEN = 0;
+        p_sched->phase_enable[SCHED_PHASE_PROX] = reg_enable.byte;
+
+        uint32_t als_phase_us = sched_als_phase_us(p_apds);
+        p_sched->period_us = SCHED_INVERSE(p_rates->als_mhz);
+        if (p_sched->period_us < als_phase_us + p_sched->prox_cycle_us)
+        {
+            p_sched->period_us = als_phase_us + p_sched->prox_cycle_us;
+        }
+
+        // Proximity runs in every cycle, the ALS one included
+        uint32_t prox_samples = 1 + (p_sched->period_us - prox_us - als_us) /
+            p_sched->prox_cycle_us;
+
+        p_sched->achieved.als_mhz = SCHED_INVERSE(p_sched->period_us);
+        p_sched->achieved.prox_mhz = (uint32_t)((uint64_t)prox_samples *
+            1000000000ull / p_sched->period_us);
+    }
+
+    if (reg_enable.GEN)
+    {
+        uint32_t dset_us;
+
+        reg_gconf2.byte = reg_shadow8(p_apds, APDS9960_GCONF2);
+        reg_gconf2.GWTIME = sched_gwtime_plan(p_rates->gesture_mhz,
+            reg_shadow8(p_apds, APDS9960_GPULSE), &dset_us);
+        p_sched->achieved.gesture_mhz = SCHED_INVERSE(dset_us);
+
+        b_is_all_ok = reg_update(p_apds, APDS9960_GCONF2, &reg_gconf2.byte, 1);
+        apds9960_gesture_decoder_reset(&p_apds->gesture_decoder);
+        p_apds->b_is_gesture_active = false;
+    }
+
+    // Shared settings are the same in both phases, switching phases is
+    // then a single ENABLE write
+    reg_config1.byte = reg_shadow8(p_apds, APDS9960_CONFIG1);
+    reg_config1.WLONG = b_is_wlong;
+
+    b_is_all_ok = b_is_all_ok &&
+        reg_update(p_apds, APDS9960_WTIME, &reg_wtime, 1) &&
+        reg_update(p_apds, APDS9960_CONFIG1, &reg_config1.byte, 1) &&
+        reg_update(p_apds, APDS9960_PPULSE, &reg_ppulse, 1) &&
+        reg_update(p_apds, APDS9960_CONFIG2, &reg_config2.byte, 1);
+
+    p_sched->phase = SCHED_PHASE_ALS;
+    b_is_all_ok = b_is_all_ok && sched_enable_write(p_apds, SCHED_PHASE_ALS);
+
+    if (b_is_all_ok && p_sched->b_is_multiplexed)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &p_sched->phase_end);
+        timespec_add_us(&p_sched->phase_end, sched_als_phase_us(p_apds));
+    }
+
+    p_sched->b_is_enabled = b_is_all_ok;
+
+    if (p_achieved)
+    {
+        *p_achieved = p_sched->achieved;
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error setting mode schedule.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+bool
+apds9960_schedule_step(apds9960_t *p_apds, const struct timespec *p_now,
+    struct timespec *p_next_deadline)
+{
+    apds9960_schedule_t *p_sched = &p_apds->schedule;
+    struct timespec now;
+    bool b_is_all_ok = true;
+
+    p_next_deadline->tv_sec = 0;
+    p_next_deadline->tv_nsec = 0;
+
+    if (!p_sched->b_is_enabled || !p_sched->b_is_multiplexed)
+    {
+        return true;
+    }
+
+    if (p_now)
+    {
+        now = *p_now;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    if (timespec_diff_ns(&now, &p_sched->phase_end) >= 0)
+    {
+        // ATIME may have been changed by auto-ranging since last plan
+        uint32_t als_phase_us = sched_als_phase_us(p_apds);
+        uint32_t phase_us = als_phase_us;
+
+        if (p_sched->phase == SCHED_PHASE_ALS)
+        {
+            p_sched->phase = SCHED_PHASE_PROX;
+            phase_us = (p_sched->period_us > als_phase_us +
+                p_sched->prox_cycle_us) ? p_sched->period_us - als_phase_us :
+                p_sched->prox_cycle_us;
+        }
+        else
+        {
+            p_sched->phase = SCHED_PHASE_ALS;
+        }
+
+        b_is_all_ok = sched_enable_write(p_apds, p_sched->phase);
+        p_sched->phase_switches++;
+
+        p_sched->phase_end = now;
+        timespec_add_us(&p_sched->phase_end, phase_us);
+    }
+
+    *p_next_deadline = p_sched->phase_end;
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error switching schedule phase.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static uint32_t
+sched_wait_plan(uint32_t wait_us, uint8_t *p_wtime, bool *p_is_wlong)
+{
+    uint32_t steps = wait_us / SCHED_STEP_US;
+    uint32_t step_us = SCHED_STEP_US;
+
+    *p_is_wlong = false;
+
+    if (steps == 0)
+    {
+        return 0;
+    }
+
+    if (steps > 256)
+    {
+        step_us *= SCHED_WLONG_FACTOR;
+        steps = wait_us / step_us;
+        *p_is_wlong = true;
+
+        if (steps > 256)
+        {
+            steps = 256;
+        }
+    }
+
+    *p_wtime = (uint8_t)(256 - steps);
+
+    return steps * step_us;
+}
+
+static uint8_t
+sched_gwtime_plan(uint32_t gesture_mhz, uint8_t gpulse, uint32_t *p_dset_us)
+{
+    uint32_t pulse_us = sched_pulse_us(gpulse, 4);
+    uint32_t period_us = SCHED_INVERSE(gesture_mhz);
+    uint8_t gwtime = GCONF2_GWTIME_0MS;
+
+    // Longest gesture wait still meeting dataset rate
+    while ((gwtime < GCONF2_GWTIME_39MS) &&
+        (pulse_us + GWTIME_US[gwtime + 1] <= period_us))
+    {
+        gwtime++;
+    }
+
+    *p_dset_us = pulse_us + GWTIME_US[gwtime];
+
+    return gwtime;
+}
+
+static uint32_t
+sched_pulse_us(uint8_t pulse_reg, uint8_t diodes)
+{
+    // PPULSE and GPULSE share layout, count in low 6 bits, length in top 2
+    apds9960_ppulse_t reg_pulse;
+    reg_pulse.byte = pulse_reg;
+
+    return SCHED_PULSE_BASE_US +
+        (uint32_t)(reg_pulse.PPULSE + 1) * (4u << reg_pulse.PPLEN) * diodes;
+}
+
+static uint32_t
+sched_als_phase_us(const apds9960_t *p_apds)
+{
+    const apds9960_schedule_t *p_sched = &p_apds->schedule;
+
+    // Proximity cycle running at switch completes first, then the ALS cycle.
+    // Host switches late rather than early, no margin is added.
+    return p_sched->prox_cycle_us + p_sched->pulse_us +
+        (uint32_t)(256 - reg_shadow8(p_apds, APDS9960_ATIME)) * SCHED_STEP_US;
+}
+
+static bool
+sched_enable_write(apds9960_t *p_apds, uint8_t phase)
+{
+    // Interrupt enables belong to the application
+    uint8_t reg_enable = (uint8_t)((p_apds->schedule.phase_enable[phase] &
+        ~SCHED_ENABLE_INT_MASK) |
+        (reg_shadow8(p_apds, APDS9960_ENABLE) & SCHED_ENABLE_INT_MASK));
+
+    return reg_update(p_apds, APDS9960_ENABLE, &reg_enable, 1);
+}
+
+/* [] END OF FILE */
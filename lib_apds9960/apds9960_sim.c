@@ -0,0 +1,972 @@
+
+#ifdef APDS9960_LINUX_HOST
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+#include "apds9960_sim.h"
+
+#define SIM_STEP_US         2780    // ADC integration and wait time step
+#define SIM_PULSE_BASE_US   700     // Fixed part of prox/gesture measurement
+#define SIM_SWIPE_STEPS     16      // Swipe script resolution
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static ssize_t
+sim_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len);
+
+static ssize_t
+sim_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len);
+
+static ssize_t
+sim_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len);
+
+static ssize_t
+sim_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+
+static void
+sim_reset(apds9960_sim_t *p_sim);
+
+static void
+sim_update(apds9960_sim_t *p_sim);
+
+static uint8_t
+sim_reg_read(apds9960_sim_t *p_sim, uint8_t reg_addr);
+
+static void
+sim_reg_write(apds9960_sim_t *p_sim, uint8_t reg_addr, uint8_t value);
+
+static void
+sim_special_function(apds9960_sim_t *p_sim, uint8_t reg_addr);
+
+static uint8_t
+sim_next_addr(uint8_t reg_addr);
+
+static uint32_t
+sim_cycle_us(apds9960_sim_t *p_sim);
+
+static void
+sim_cycle_run(apds9960_sim_t *p_sim);
+
+static void
+sim_cycle_prox(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input);
+
+static void
+sim_cycle_als(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input);
+
+static void
+sim_cycle_gesture(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input);
+
+static void
+sim_input_at(apds9960_sim_t *p_sim, uint64_t time_us,
+    apds9960_sim_frame_t *p_input);
+
+static void
+sim_diodes(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input,
+    uint8_t gain_code, const uint8_t *p_offsets, uint8_t *p_diodes);
+
+static bool
+sim_is_persistent(uint8_t *p_count, bool b_is_out, uint8_t pers_cycles);
+
+static void
+sim_fifo_push(apds9960_sim_t *p_sim, const uint8_t *p_dataset);
+
+static void
+sim_fifo_clear(apds9960_sim_t *p_sim);
+
+static void
+sim_gesture_status_update(apds9960_sim_t *p_sim);
+
+static bool
+sim_int_level(apds9960_sim_t *p_sim);
+
+static void
+sim_int_update(apds9960_sim_t *p_sim);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+const apds9960_transport_t apds9960_transport_sim = {
+    .name = "sim",
+    .read = sim_read,
+    .write = sim_write,
+    .write_then_read = sim_write_then_read,
+    .transfer = sim_transfer
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+apds9960_sim_t
+*apds9960_sim_open(bool b_is_manual_clock)
+{
+    apds9960_sim_t *p_sim = calloc(1, sizeof(apds9960_sim_t));
+
+    if (p_sim)
+    {
+        p_sim->b_is_manual_clock = b_is_manual_clock;
+        clock_gettime(CLOCK_MONOTONIC, &p_sim->clock_origin);
+        sim_reset(p_sim);
+    }
+    else
+    {
+        ERROR("Not enough free memory.", __FUNCTION__);
+    }
+
+    return p_sim;
+}
+
+void
+apds9960_sim_close(apds9960_sim_t *p_sim)
+{
+    free(p_sim);
+}
+
+void
+apds9960_sim_load_script(apds9960_sim_t *p_sim,
+    const apds9960_sim_frame_t *p_frames, size_t frame_count, bool b_is_looped)
+{
+    sim_update(p_sim);
+
+    p_sim->p_script = p_frames;
+    p_sim->script_len = frame_count;
+    p_sim->b_is_script_looped = b_is_looped;
+    p_sim->script_start_us = p_sim->now_us;
+}
+
+void
+apds9960_sim_advance(apds9960_sim_t *p_sim, uint32_t time_us)
+{
+    if (p_sim->b_is_manual_clock)
+    {
+        p_sim->now_us += time_us;
+    }
+
+    sim_update(p_sim);
+}
+
+bool
+apds9960_sim_is_int_asserted(apds9960_sim_t *p_sim)
+{
+    sim_update(p_sim);
+
+    return sim_int_level(p_sim);
+}
+
+size_t
+apds9960_sim_script_swipe(apds9960_sim_frame_t *p_frames, size_t max_frames,
+    uint32_t start_ms, uint32_t duration_ms, int direction, uint8_t peak)
+{
+    // Hand passes the leading diode first, the trailing one last
+    // and both perpendicular diodes in the middle of the swipe
+    int centre[SIM_DIODE_ALL];
+    int lead;
+    int trail;
+
+    switch (direction)
+    {
+        case GESTURE_DIR_UP:
+            lead = SIM_DIODE_U;
+            trail = SIM_DIODE_D;
+            break;
+
+        case GESTURE_DIR_DOWN:
+            lead = SIM_DIODE_D;
+            trail = SIM_DIODE_U;
+            break;
+
+        case GESTURE_DIR_LEFT:
+            lead = SIM_DIODE_L;
+            trail = SIM_DIODE_R;
+            break;
+
+        case GESTURE_DIR_RIGHT:
+            lead = SIM_DIODE_R;
+            trail = SIM_DIODE_L;
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (max_frames < SIM_SWIPE_STEPS + 1)
+    {
+        return 0;
+    }
+
+    // Diode response centres in 1/100 of swipe duration
+    for (int diode = 0; diode < SIM_DIODE_ALL; diode++)
+    {
+        centre[diode] = 50;
+    }
+    centre[lead] = 40;
+    centre[trail] = 60;
+
+    for (int step = 0; step <= SIM_SWIPE_STEPS; step++)
+    {
+        apds9960_sim_frame_t *p_frame = &p_frames[step];
+        int pos = (step * 100) / SIM_SWIPE_STEPS;
+
+        memset(p_frame, 0, sizeof(apds9960_sim_frame_t));
+        p_frame->time_ms = start_ms + (duration_ms * step) / SIM_SWIPE_STEPS;
+
+        // Triangular response, 35 % of swipe duration to either side
+        for (int diode = 0; diode < SIM_DIODE_ALL; diode++)
+        {
+            int dist = abs(pos - centre[diode]);
+
+            if ((step > 0) && (step < SIM_SWIPE_STEPS) && (dist < 35))
+            {
+                p_frame->diode[diode] = (uint8_t)((peak * (35 - dist)) / 35);
+            }
+        }
+    }
+
+    return SIM_SWIPE_STEPS + 1;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static ssize_t
+sim_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len)
+{
+    apds9960_i2c_msg_t msg = { p_data, (uint32_t)data_len, true };
+
+    return sim_transfer(p_ctx, i2c_fd, i2c_addr, &msg, 1);
+}
+
+static ssize_t
+sim_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len)
+{
+    // Message buffer is not modified on write
+    apds9960_i2c_msg_t msg = { (uint8_t *)p_data, (uint32_t)data_len, false };
+
+    return sim_transfer(p_ctx, i2c_fd, i2c_addr, &msg, 1);
+}
+
+static ssize_t
+sim_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len)
+{
+    apds9960_i2c_msg_t msgs[2] = {
+        { (uint8_t *)p_wr_data, (uint32_t)wr_len, false },
+        { p_rd_data, (uint32_t)rd_len, true }
+    };
+
+    return sim_transfer(p_ctx, i2c_fd, i2c_addr, msgs, 2);
+}
+
+static ssize_t
+sim_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count)
+{
+    apds9960_sim_t *p_sim = (apds9960_sim_t *)p_ctx;
+    ssize_t total = 0;
+
+    // Device does not acknowledge foreign address
+    if ((i2c_addr != APDS9960_I2C_ADDRESS) || (msg_count == 0))
+    {
+        errno = (msg_count == 0) ? EINVAL : ENXIO;
+        return -1;
+    }
+
+    sim_update(p_sim);
+
+    for (size_t idx = 0; idx < msg_count; idx++)
+    {
+        uint8_t *p_buf = p_msgs[idx].p_buf;
+        uint32_t len = p_msgs[idx].len;
+
+        if (p_msgs[idx].b_is_read)
+        {
+            // Auto-increment read from register pointer
+            for (uint32_t pos = 0; pos < len; pos++)
+            {
+                p_buf[pos] = sim_reg_read(p_sim, p_sim->reg_ptr);
+                p_sim->reg_ptr = sim_next_addr(p_sim->reg_ptr);
+            }
+        }
+        else if (len > 0)
+        {
+            // First byte sets register pointer, rest is auto-increment write
+            p_sim->reg_ptr = p_buf[0];
+
+            if ((p_buf[0] >= APDS9960_IFORCE) && (p_buf[0] <= APDS9960_AICLEAR))
+            {
+                sim_special_function(p_sim, p_buf[0]);
+            }
+
+            for (uint32_t pos = 1; pos < len; pos++)
+            {
+                sim_reg_write(p_sim, p_sim->reg_ptr, p_buf[pos]);
+                p_sim->reg_ptr = sim_next_addr(p_sim->reg_ptr);
+            }
+        }
+
+        total += len;
+    }
+
+    sim_int_update(p_sim);
+
+    return total;
+}
+
+static void
+sim_reset(apds9960_sim_t *p_sim)
+{
+    memset(p_sim->regs, 0, sizeof(p_sim->regs));
+
+    // Power-on register defaults
+    p_sim->regs[APDS9960_ATIME] = 0xFF;
+    p_sim->regs[APDS9960_WTIME] = 0xFF;
+    p_sim->regs[APDS9960_CONFIG1] = 0x40;
+    p_sim->regs[APDS9960_CONFIG2] = 0x01;
+    p_sim->regs[APDS9960_ID] = APDS9960_DEVICE_ID;
+
+    p_sim->reg_ptr = 0;
+    p_sim->als_pers_count = 0;
+    p_sim->prox_pers_count = 0;
+    p_sim->gesture_exit_count = 0;
+    p_sim->b_is_sleeping = false;
+    sim_fifo_clear(p_sim);
+}
+
+static void
+sim_update(apds9960_sim_t *p_sim)
+{
+    struct timespec now;
+
+    if (!p_sim->b_is_manual_clock)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        p_sim->now_us = (uint64_t)(timespec_diff_ns(&now,
+            &p_sim->clock_origin) / 1000);
+    }
+
+    // Run every measurement cycle completed since last update
+    while ((p_sim->regs[APDS9960_ENABLE] & 0x01) && !p_sim->b_is_sleeping &&
+        (p_sim->cycle_end_us <= p_sim->now_us))
+    {
+        sim_cycle_run(p_sim);
+        p_sim->cycle_end_us += sim_cycle_us(p_sim);
+    }
+}
+
+static uint8_t
+sim_reg_read(apds9960_sim_t *p_sim, uint8_t reg_addr)
+{
+    uint8_t value = 0;
+
+    if (reg_addr >= APDS9960_GFIFO_U)
+    {
+        if (p_sim->fifo_level > 0)
+        {
+            value = p_sim->fifo[p_sim->fifo_head][reg_addr - APDS9960_GFIFO_U];
+
+            // Dataset is consumed by reading RIGHT value
+            if (reg_addr == APDS9960_GFIFO_R)
+            {
+                p_sim->fifo_head =
+                    (p_sim->fifo_head + 1) % APDS9960_SIM_FIFO_DEPTH;
+                p_sim->fifo_level--;
+                sim_gesture_status_update(p_sim);
+            }
+        }
+    }
+    else if (reg_addr >= APDS9960_IFORCE)
+    {
+        // Special functions are write-only
+    }
+    else
+    {
+        value = p_sim->regs[reg_addr];
+
+        // Reading data clears the related valid flag
+        if ((reg_addr >= APDS9960_CDATAL) && (reg_addr <= APDS9960_BDATAH))
+        {
+            p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0x01;
+        }
+        else if (reg_addr == APDS9960_PDATA)
+        {
+            p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0x02;
+        }
+    }
+
+    return value;
+}
+
+static void
+sim_reg_write(apds9960_sim_t *p_sim, uint8_t reg_addr, uint8_t value)
+{
+    uint8_t previous = p_sim->regs[reg_addr];
+
+    if ((reg_addr < APDS9960_ENABLE) ||
+        ((reg_addr >= APDS9960_ID) && (reg_addr <= APDS9960_PDATA)) ||
+        (reg_addr > APDS9960_GCONF4))
+    {
+        // Read-only or reserved register
+        return;
+    }
+
+    p_sim->regs[reg_addr] = value;
+
+    if (reg_addr == APDS9960_ENABLE)
+    {
+        if ((value & 0x01) && !(previous & 0x01))
+        {
+            // Power on, first cycle starts now
+            p_sim->cycle_end_us = p_sim->now_us + sim_cycle_us(p_sim);
+        }
+
+        if (!(value & 0x40))
+        {
+            // Gesture engine off leaves gesture mode
+            p_sim->regs[APDS9960_GCONF4] &= (uint8_t)~0x01;
+        }
+    }
+    else if (reg_addr == APDS9960_GCONF4)
+    {
+        if (value & 0x04)
+        {
+            // GFIFO_CLR is self-clearing
+            sim_fifo_clear(p_sim);
+            p_sim->regs[APDS9960_GCONF4] &= (uint8_t)~0x04;
+        }
+    }
+}
+
+static void
+sim_special_function(apds9960_sim_t *p_sim, uint8_t reg_addr)
+{
+    switch (reg_addr)
+    {
+        case APDS9960_IFORCE:
+            p_sim->regs[APDS9960_STATUS] |= 0x30;
+            break;
+
+        // Saturation flags are cleared along with their channel interrupt
+        case APDS9960_PICLEAR:
+            p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0x60;
+            break;
+
+        case APDS9960_CICLEAR:
+            p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0x90;
+            break;
+
+        case APDS9960_AICLEAR:
+            p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0xF0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static uint8_t
+sim_next_addr(uint8_t reg_addr)
+{
+    // Burst read of gesture FIFO wraps within FIFO registers
+    return (reg_addr == APDS9960_GFIFO_R) ? APDS9960_GFIFO_U : reg_addr + 1;
+}
+
+static uint32_t
+sim_cycle_us(apds9960_sim_t *p_sim)
+{
+    static const uint32_t GWTIME_US[8] = {
+        0, 2800, 5600, 8400, 14000, 22400, 30800, 39200
+    };
+
+    apds9960_enable_t reg_enable;
+    apds9960_config1_t reg_config1;
+    apds9960_ppulse_t reg_ppulse;
+    apds9960_gpulse_t reg_gpulse;
+    apds9960_gconf2_t reg_gconf2;
+    uint32_t cycle_us = 0;
+
+    // Called as a cycle starts, later ENABLE writes apply to the next one
+    reg_enable.byte = p_sim->regs[APDS9960_ENABLE];
+    p_sim->cycle_enable = reg_enable.byte;
+
+    if (p_sim->regs[APDS9960_GCONF4] & 0x01)
+    {
+        // Gesture cycle: all four diodes pulsed, then gesture wait
+        reg_gpulse.byte = p_sim->regs[APDS9960_GPULSE];
+        reg_gconf2.byte = p_sim->regs[APDS9960_GCONF2];
+        cycle_us = SIM_PULSE_BASE_US +
+            (reg_gpulse.GPULSE + 1) * (4u << reg_gpulse.GPLEN) * 4 +
+            GWTIME_US[reg_gconf2.GWTIME];
+    }
+    else
+    {
+        if (reg_enable.PEN)
+        {
+            reg_ppulse.byte = p_sim->regs[APDS9960_PPULSE];
+            cycle_us += SIM_PULSE_BASE_US +
+                (reg_ppulse.PPULSE + 1) * (4u << reg_ppulse.PPLEN) * 2;
+        }
+
+        if (reg_enable.AEN)
+        {
+            cycle_us += (256 - p_sim->regs[APDS9960_ATIME]) * SIM_STEP_US;
+        }
+
+        if (reg_enable.WEN)
+        {
+            reg_config1.byte = p_sim->regs[APDS9960_CONFIG1];
+            cycle_us += (256 - p_sim->regs[APDS9960_WTIME]) * SIM_STEP_US *
+                (reg_config1.WLONG ? 12 : 1);
+        }
+    }
+
+    // Idle state machine still polls its enables
+    return (cycle_us > 0) ? cycle_us : SIM_STEP_US;
+}
+
+static void
+sim_cycle_run(apds9960_sim_t *p_sim)
+{
+    apds9960_sim_frame_t input;
+    apds9960_enable_t reg_enable;
+
+    // Engines run as enabled when the cycle started
+    reg_enable.byte = p_sim->cycle_enable;
+    sim_input_at(p_sim, p_sim->cycle_end_us, &input);
+
+    if (p_sim->regs[APDS9960_GCONF4] & 0x01)
+    {
+        sim_cycle_gesture(p_sim, &input);
+    }
+    else
+    {
+        if (reg_enable.PEN)
+        {
+            sim_cycle_prox(p_sim, &input);
+        }
+
+        // Proximity above GPENTH starts gesture mode instead of ALS
+        if ((p_sim->regs[APDS9960_GCONF4] & 0x01) == 0 && reg_enable.AEN)
+        {
+            sim_cycle_als(p_sim, &input);
+        }
+    }
+
+    sim_int_update(p_sim);
+}
+
+static void
+sim_cycle_prox(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input)
+{
+    uint8_t diodes[SIM_DIODE_ALL];
+    uint8_t offsets[SIM_DIODE_ALL];
+    uint32_t sum = 0;
+    uint32_t count = 0;
+    uint8_t pdata;
+
+    apds9960_control_t reg_control;
+    apds9960_config3_t reg_config3;
+    apds9960_pers_t reg_pers;
+    apds9960_enable_t reg_enable;
+
+    reg_control.byte = p_sim->regs[APDS9960_CONTROL];
+    reg_config3.byte = p_sim->regs[APDS9960_CONFIG3];
+    reg_pers.byte = p_sim->regs[APDS9960_PERS];
+    reg_enable.byte = p_sim->regs[APDS9960_ENABLE];
+
+    // POFFSET_UR applies to UP and RIGHT, POFFSET_DL to DOWN and LEFT
+    offsets[SIM_DIODE_U] = p_sim->regs[APDS9960_POFFSET_UR];
+    offsets[SIM_DIODE_R] = p_sim->regs[APDS9960_POFFSET_UR];
+    offsets[SIM_DIODE_D] = p_sim->regs[APDS9960_POFFSET_DL];
+    offsets[SIM_DIODE_L] = p_sim->regs[APDS9960_POFFSET_DL];
+
+    sim_diodes(p_sim, p_input, reg_control.PGAIN, offsets, diodes);
+
+    // Average of diodes not masked out in CONFIG3
+    if (!reg_config3.PMASK_U) { sum += diodes[SIM_DIODE_U]; count++; }
+    if (!reg_config3.PMASK_D) { sum += diodes[SIM_DIODE_D]; count++; }
+    if (!reg_config3.PMASK_L) { sum += diodes[SIM_DIODE_L]; count++; }
+    if (!reg_config3.PMASK_R) { sum += diodes[SIM_DIODE_R]; count++; }
+    pdata = (count > 0) ? (uint8_t)(sum / count) : 0;
+
+    p_sim->regs[APDS9960_PDATA] = pdata;
+    p_sim->regs[APDS9960_STATUS] |= 0x02;
+
+    // Full scale reflection stands in for analog saturation
+    if (pdata == 0xFF)
+    {
+        p_sim->regs[APDS9960_STATUS] |= 0x40;
+    }
+
+    if (sim_is_persistent(&p_sim->prox_pers_count,
+        (pdata < p_sim->regs[APDS9960_PILT]) ||
+        (pdata > p_sim->regs[APDS9960_PIHT]), reg_pers.PPERS))
+    {
+        p_sim->regs[APDS9960_STATUS] |= 0x20;
+    }
+
+    if (reg_enable.GEN && (pdata >= p_sim->regs[APDS9960_GPENTH]))
+    {
+        p_sim->regs[APDS9960_GCONF4] |= 0x01;
+        p_sim->gesture_exit_count = 0;
+    }
+}
+
+static void
+sim_cycle_als(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input)
+{
+    static const uint32_t AGAIN_MULT[4] = { 1, 4, 16, 64 };
+
+    const uint16_t *p_levels = &p_input->light.clear;
+    uint32_t steps = 256 - p_sim->regs[APDS9960_ATIME];
+    uint32_t max_count = steps * 1025;
+    uint16_t thold_low;
+    uint16_t thold_high;
+    uint16_t cdata = 0;
+
+    apds9960_control_t reg_control;
+    apds9960_pers_t reg_pers;
+
+    reg_control.byte = p_sim->regs[APDS9960_CONTROL];
+    reg_pers.byte = p_sim->regs[APDS9960_PERS];
+
+    if (max_count > 0xFFFF)
+    {
+        max_count = 0xFFFF;
+    }
+
+    // Clear, red, green and blue data registers in order
+    for (int channel = 0; channel < 4; channel++)
+    {
+        uint32_t value = p_levels[channel] * steps * AGAIN_MULT[reg_control.AGAIN];
+
+        if (value > max_count)
+        {
+            value = max_count;
+        }
+
+        if (channel == 0)
+        {
+            cdata = (uint16_t)value;
+        }
+
+        p_sim->regs[APDS9960_CDATAL + channel * 2] = (uint8_t)(value & 0xFF);
+        p_sim->regs[APDS9960_CDATAH + channel * 2] = (uint8_t)(value >> 8);
+    }
+
+    p_sim->regs[APDS9960_STATUS] |= 0x01;
+
+    if (cdata == max_count)
+    {
+        p_sim->regs[APDS9960_STATUS] |= 0x80;
+    }
+
+    thold_low = (uint16_t)(p_sim->regs[APDS9960_AILTL] |
+        (p_sim->regs[APDS9960_AILTH] << 8));
+    thold_high = (uint16_t)(p_sim->regs[APDS9960_AIHTL] |
+        (p_sim->regs[APDS9960_AIHTH] << 8));
+
+    // APERS 1..3 is cycle count, then multiples of 5
+    if (sim_is_persistent(&p_sim->als_pers_count,
+        (cdata < thold_low) || (cdata > thold_high),
+        (reg_pers.APERS > 3) ? (reg_pers.APERS - 3) * 5 : reg_pers.APERS))
+    {
+        p_sim->regs[APDS9960_STATUS] |= 0x10;
+    }
+}
+
+static void
+sim_cycle_gesture(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input)
+{
+    static const uint8_t GEXPERS_CYCLES[4] = { 1, 2, 4, 7 };
+
+    uint8_t dataset[SIM_DIODE_ALL];
+    uint8_t offsets[SIM_DIODE_ALL];
+    bool b_is_exit = true;
+
+    apds9960_gconf1_t reg_gconf1;
+    apds9960_gconf2_t reg_gconf2;
+    apds9960_gconf3_t reg_gconf3;
+
+    reg_gconf1.byte = p_sim->regs[APDS9960_GCONF1];
+    reg_gconf2.byte = p_sim->regs[APDS9960_GCONF2];
+    reg_gconf3.byte = p_sim->regs[APDS9960_GCONF3];
+
+    offsets[SIM_DIODE_U] = p_sim->regs[APDS9960_GOFFSET_U];
+    offsets[SIM_DIODE_D] = p_sim->regs[APDS9960_GOFFSET_D];
+    offsets[SIM_DIODE_L] = p_sim->regs[APDS9960_GOFFSET_L];
+    offsets[SIM_DIODE_R] = p_sim->regs[APDS9960_GOFFSET_R];
+
+    sim_diodes(p_sim, p_input, reg_gconf2.GGAIN, offsets, dataset);
+
+    // Unselected gesture dimension reads as zero
+    if (reg_gconf3.GDIMS == GCONF2_GDIMS_UD)
+    {
+        dataset[SIM_DIODE_L] = 0;
+        dataset[SIM_DIODE_R] = 0;
+    }
+    else if (reg_gconf3.GDIMS == GCONF2_GDIMS_LR)
+    {
+        dataset[SIM_DIODE_U] = 0;
+        dataset[SIM_DIODE_D] = 0;
+    }
+
+    sim_fifo_push(p_sim, dataset);
+
+    // Exit when all diodes not masked by GEXMSK (bit 3 UP .. bit 0 RIGHT)
+    // stay below GEXTH for GEXPERS cycles
+    for (int diode = 0; diode < SIM_DIODE_ALL; diode++)
+    {
+        if (!(reg_gconf1.GEXMSK & (0x08 >> diode)) &&
+            (dataset[diode] >= p_sim->regs[APDS9960_GEXTH]))
+        {
+            b_is_exit = false;
+        }
+    }
+
+    if (b_is_exit)
+    {
+        p_sim->gesture_exit_count++;
+        if (p_sim->gesture_exit_count >= GEXPERS_CYCLES[reg_gconf1.GEXPERS])
+        {
+            p_sim->regs[APDS9960_GCONF4] &= (uint8_t)~0x01;
+            p_sim->gesture_exit_count = 0;
+        }
+    }
+    else
+    {
+        p_sim->gesture_exit_count = 0;
+    }
+}
+
+static void
+sim_input_at(apds9960_sim_t *p_sim, uint64_t time_us,
+    apds9960_sim_frame_t *p_input)
+{
+    const apds9960_sim_frame_t *p_frames = p_sim->p_script;
+    uint64_t script_ms;
+    size_t idx;
+
+    memset(p_input, 0, sizeof(apds9960_sim_frame_t));
+
+    if ((p_frames == NULL) || (p_sim->script_len == 0) ||
+        (time_us < p_sim->script_start_us))
+    {
+        return;
+    }
+
+    script_ms = (time_us - p_sim->script_start_us) / 1000;
+
+    if (p_sim->b_is_script_looped &&
+        (p_frames[p_sim->script_len - 1].time_ms > 0))
+    {
+        script_ms %= p_frames[p_sim->script_len - 1].time_ms;
+    }
+
+    // Hold first and last keyframe outside script range
+    if (script_ms <= p_frames[0].time_ms)
+    {
+        *p_input = p_frames[0];
+        return;
+    }
+
+    for (idx = 1; idx < p_sim->script_len; idx++)
+    {
+        if (script_ms < p_frames[idx].time_ms)
+        {
+            break;
+        }
+    }
+
+    if (idx == p_sim->script_len)
+    {
+        *p_input = p_frames[idx - 1];
+        return;
+    }
+
+    // Linear interpolation between surrounding keyframes
+    const apds9960_sim_frame_t *p_a = &p_frames[idx - 1];
+    const apds9960_sim_frame_t *p_b = &p_frames[idx];
+    int64_t span = p_b->time_ms - p_a->time_ms;
+    int64_t pos = (int64_t)script_ms - p_a->time_ms;
+
+#   define SIM_LERP(a, b) ((a) + (((int64_t)(b) - (a)) * pos) / span)
+    p_input->time_ms = (uint32_t)script_ms;
+    p_input->light.clear = (uint16_t)SIM_LERP(p_a->light.clear, p_b->light.clear);
+    p_input->light.red = (uint16_t)SIM_LERP(p_a->light.red, p_b->light.red);
+    p_input->light.green = (uint16_t)SIM_LERP(p_a->light.green, p_b->light.green);
+    p_input->light.blue = (uint16_t)SIM_LERP(p_a->light.blue, p_b->light.blue);
+    for (int diode = 0; diode < SIM_DIODE_ALL; diode++)
+    {
+        p_input->diode[diode] =
+            (uint8_t)SIM_LERP(p_a->diode[diode], p_b->diode[diode]);
+    }
+#   undef SIM_LERP
+}
+
+static void
+sim_diodes(apds9960_sim_t *p_sim, const apds9960_sim_frame_t *p_input,
+    uint8_t gain_code, const uint8_t *p_offsets, uint8_t *p_diodes)
+{
+    for (int diode = 0; diode < SIM_DIODE_ALL; diode++)
+    {
+        // Scripted values are at 4x gain, offsets are sign-magnitude
+        int value = ((p_input->diode[diode] + p_sim->crosstalk[diode]) <<
+            gain_code) / 4;
+        int offset = p_offsets[diode] & 0x7F;
+
+        value += (p_offsets[diode] & 0x80) ? offset : -offset;
+
+        if (value < 0)
+        {
+            value = 0;
+        }
+        else if (value > 0xFF)
+        {
+            value = 0xFF;
+        }
+
+        p_diodes[diode] = (uint8_t)value;
+    }
+}
+
+static bool
+sim_is_persistent(uint8_t *p_count, bool b_is_out, uint8_t pers_cycles)
+{
+    bool b_is_interrupt = false;
+
+    // Zero persistence interrupts on every cycle
+    if (pers_cycles == 0)
+    {
+        b_is_interrupt = true;
+    }
+    else if (b_is_out)
+    {
+        if (*p_count < 0xFF)
+        {
+            (*p_count)++;
+        }
+        b_is_interrupt = (*p_count >= pers_cycles);
+    }
+    else
+    {
+        *p_count = 0;
+    }
+
+    return b_is_interrupt;
+}
+
+static void
+sim_fifo_push(apds9960_sim_t *p_sim, const uint8_t *p_dataset)
+{
+    if (p_sim->fifo_level < APDS9960_SIM_FIFO_DEPTH)
+    {
+        uint8_t tail = (p_sim->fifo_head + p_sim->fifo_level) %
+            APDS9960_SIM_FIFO_DEPTH;
+
+        memcpy(p_sim->fifo[tail], p_dataset, SIM_DIODE_ALL);
+        p_sim->fifo_level++;
+    }
+    else
+    {
+        // Dataset is lost when FIFO is full
+        p_sim->regs[APDS9960_GSTATUS] |= 0x02;
+    }
+
+    sim_gesture_status_update(p_sim);
+}
+
+static void
+sim_fifo_clear(apds9960_sim_t *p_sim)
+{
+    p_sim->fifo_head = 0;
+    p_sim->fifo_level = 0;
+    p_sim->regs[APDS9960_GSTATUS] = 0;
+    sim_gesture_status_update(p_sim);
+}
+
+static void
+sim_gesture_status_update(apds9960_sim_t *p_sim)
+{
+    static const uint8_t GFIFOTH_LEVEL[4] = { 1, 4, 8, 16 };
+
+    apds9960_gconf1_t reg_gconf1;
+    reg_gconf1.byte = p_sim->regs[APDS9960_GCONF1];
+
+    p_sim->regs[APDS9960_GFLVL] = p_sim->fifo_level;
+
+    // GVALID is set at FIFO threshold and cleared when FIFO is empty
+    if (p_sim->fifo_level == 0)
+    {
+        p_sim->regs[APDS9960_GSTATUS] = 0;
+    }
+    else if (p_sim->fifo_level >= GFIFOTH_LEVEL[reg_gconf1.GFIFOTH])
+    {
+        p_sim->regs[APDS9960_GSTATUS] |= 0x01;
+    }
+
+    if (p_sim->regs[APDS9960_GSTATUS] & 0x01)
+    {
+        p_sim->regs[APDS9960_STATUS] |= 0x04;
+    }
+    else
+    {
+        p_sim->regs[APDS9960_STATUS] &= (uint8_t)~0x04;
+    }
+}
+
+static bool
+sim_int_level(apds9960_sim_t *p_sim)
+{
+    apds9960_status_t reg_status;
+    apds9960_enable_t reg_enable;
+    apds9960_gconf4_t reg_gconf4;
+    apds9960_config2_t reg_config2;
+
+    reg_status.byte = p_sim->regs[APDS9960_STATUS];
+    reg_enable.byte = p_sim->regs[APDS9960_ENABLE];
+    reg_gconf4.byte = p_sim->regs[APDS9960_GCONF4];
+    reg_config2.byte = p_sim->regs[APDS9960_CONFIG2];
+
+    return (reg_status.AINT && reg_enable.AIEN) ||
+        (reg_status.PINT && reg_enable.PIEN) ||
+        (reg_status.GINT && reg_gconf4.GIEN) ||
+        (reg_status.CPSAT && reg_config2.CPSIEN) ||
+        (reg_status.PGSAT && reg_config2.PSIEN);
+}
+
+static void
+sim_int_update(apds9960_sim_t *p_sim)
+{
+    bool b_was_sleeping = p_sim->b_is_sleeping;
+    apds9960_config3_t reg_config3;
+    reg_config3.byte = p_sim->regs[APDS9960_CONFIG3];
+
+    // Sleep After Interrupt halts state machine until INT is cleared
+    p_sim->b_is_sleeping = reg_config3.SAI && sim_int_level(p_sim);
+
+    if (b_was_sleeping && !p_sim->b_is_sleeping)
+    {
+        p_sim->cycle_end_us = p_sim->now_us + sim_cycle_us(p_sim);
+    }
+}
+
+#endif // APDS9960_LINUX_HOST
+
+/* [] END OF FILE */
@@ -0,0 +1,119 @@
+
+#ifndef APDS9960_LINUX_HOST
+
+#include <stdbool.h>
+#include <errno.h>
+
+#include <applibs/i2c.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static ssize_t
+applibs_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len);
+
+static ssize_t
+applibs_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len);
+
+static ssize_t
+applibs_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len);
+
+static ssize_t
+applibs_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+const apds9960_transport_t apds9960_transport_applibs = {
+    .name = "applibs",
+    .read = applibs_read,
+    .write = applibs_write,
+    .write_then_read = applibs_write_then_read,
+    .transfer = applibs_transfer
+};
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static ssize_t
+applibs_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len)
+{
+    return I2CMaster_Read(i2c_fd, i2c_addr, p_data, data_len);
+}
+
+static ssize_t
+applibs_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len)
+{
+    return I2CMaster_Write(i2c_fd, i2c_addr, p_data, data_len);
+}
+
+static ssize_t
+applibs_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len)
+{
+    return I2CMaster_WriteThenRead(i2c_fd, i2c_addr, p_wr_data, wr_len,
+        p_rd_data, rd_len);
+}
+
+static ssize_t
+applibs_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count)
+{
+    // Applibs has no generic combined transfer. Write followed by read is
+    // mapped onto I2CMaster_WriteThenRead, everything else is sent as
+    // separate transactions.
+    ssize_t total = 0;
+    ssize_t result;
+    size_t idx = 0;
+
+    while (idx < msg_count)
+    {
+        if (!p_msgs[idx].b_is_read && (idx + 1 < msg_count) &&
+            p_msgs[idx + 1].b_is_read)
+        {
+            result = I2CMaster_WriteThenRead(i2c_fd, i2c_addr,
+                p_msgs[idx].p_buf, p_msgs[idx].len,
+                p_msgs[idx + 1].p_buf, p_msgs[idx + 1].len);
+            idx += 2;
+        }
+        else if (p_msgs[idx].b_is_read)
+        {
+            result = I2CMaster_Read(i2c_fd, i2c_addr, p_msgs[idx].p_buf,
+                p_msgs[idx].len);
+            idx++;
+        }
+        else
+        {
+            result = I2CMaster_Write(i2c_fd, i2c_addr, p_msgs[idx].p_buf,
+                p_msgs[idx].len);
+            idx++;
+        }
+
+        if (result == -1)
+        {
+            total = -1;
+            break;
+        }
+        total += result;
+    }
+
+    return total;
+}
+
+#endif // APDS9960_LINUX_HOST
+
+/* [] END OF FILE */
@@ -0,0 +1,145 @@
+
+#ifdef APDS9960_LINUX_HOST
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_common.h"
+
+// Maximum number of messages in one I2C_RDWR request (kernel limit)
+#define I2CDEV_MSGS_MAX     42
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static ssize_t
+i2cdev_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len);
+
+static ssize_t
+i2cdev_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len);
+
+static ssize_t
+i2cdev_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len);
+
+static ssize_t
+i2cdev_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+const apds9960_transport_t apds9960_transport_i2cdev = {
+    .name = "i2cdev",
+    .read = i2cdev_read,
+    .write = i2cdev_write,
+    .write_then_read = i2cdev_write_then_read,
+    .transfer = i2cdev_transfer
+};
+
+/*******************************************************************************
+* Public function definitions
+*******************************************************************************/
+
+int
+apds9960_i2cdev_open(unsigned int bus_number)
+{
+    char path[32];
+
+    snprintf(path, sizeof(path), "/dev/i2c-%u", bus_number);
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1)
+    {
+        ERROR("Cannot open %s: %d.", __FUNCTION__, path, errno);
+    }
+
+    return fd;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static ssize_t
+i2cdev_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len)
+{
+    apds9960_i2c_msg_t msg = { p_data, (uint32_t)data_len, true };
+
+    return i2cdev_transfer(p_ctx, i2c_fd, i2c_addr, &msg, 1);
+}
+
+static ssize_t
+i2cdev_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len)
+{
+    // Message buffer is not modified on write
+    apds9960_i2c_msg_t msg = { (uint8_t *)p_data, (uint32_t)data_len, false };
+
+    return i2cdev_transfer(p_ctx, i2c_fd, i2c_addr, &msg, 1);
+}
+
+static ssize_t
+i2cdev_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len)
+{
+    apds9960_i2c_msg_t msgs[2] = {
+        { (uint8_t *)p_wr_data, (uint32_t)wr_len, false },
+        { p_rd_data, (uint32_t)rd_len, true }
+    };
+
+    return i2cdev_transfer(p_ctx, i2c_fd, i2c_addr, msgs, 2);
+}
+
+static ssize_t
+i2cdev_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count)
+{
+    struct i2c_msg msgs[I2CDEV_MSGS_MAX];
+    struct i2c_rdwr_ioctl_data rdwr;
+    ssize_t total = 0;
+
+    if ((msg_count == 0) || (msg_count > I2CDEV_MSGS_MAX))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t idx = 0; idx < msg_count; idx++)
+    {
+        msgs[idx].addr = (__u16)i2c_addr;
+        msgs[idx].flags = p_msgs[idx].b_is_read ? I2C_M_RD : 0;
+        msgs[idx].len = (__u16)p_msgs[idx].len;
+        msgs[idx].buf = p_msgs[idx].p_buf;
+        total += p_msgs[idx].len;
+    }
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = (__u32)msg_count;
+
+    if (ioctl(i2c_fd, I2C_RDWR, &rdwr) < 0)
+    {
+        total = -1;
+    }
+
+    return total;
+}
+
+#endif // APDS9960_LINUX_HOST
+
+/* [] END OF FILE */
@@ -16,12 +16,84 @@
 #include <errno.h>
 #include <string.h>
 
-#include <applibs/log.h>
-#include <applibs/i2c.h>
-
 #include "lib_apds9960.h"
 #include "apds9960_common.h"
 
+// Every APDS_INIT_* value loaded by apds9960_open and its register field
+// X(r, register, field LSB, field width in bits, APDS_INIT_ name)
+#define INIT_FIELDS(X, r) \
+    X(r, APDS9960_ATIME,      0, 8,  ATIME)                 \
+    X(r, APDS9960_WTIME,      0, 8,  WTIME)                 \
+    X(r, APDS9960_AILTL,      0, 16, AILT)                  \
+    X(r, APDS9960_AIHTL,      0, 16, AIHT)                  \
+    X(r, APDS9960_PILT,       0, 8,  PILT)                  \
+    X(r, APDS9960_PIHT,       0, 8,  PIHT)                  \
+    X(r, APDS9960_PERS,       0, 8,  PERS)                  \
+    X(r, APDS9960_CONFIG1,    0, 8,  CONFIG1)               \
+    X(r, APDS9960_PPULSE,     0, 8,  PPULSE_PROX)           \
+    X(r, APDS9960_CONTROL,    0, 2,  AGAIN)                 \
+    X(r, APDS9960_CONTROL,    2, 2,  PGAIN)                 \
+    X(r, APDS9960_CONTROL,    6, 2,  LDRIVE)                \
+    X(r, APDS9960_CONFIG2,    0, 8,  CONFIG2)               \
+    X(r, APDS9960_POFFSET_UR, 0, 8,  POFFSET_UR)            \
+    X(r, APDS9960_POFFSET_DL, 0, 8,  POFFSET_DL)            \
+    X(r, APDS9960_CONFIG3,    0, 8,  CONFIG3)               \
+    X(r, APDS9960_GPENTH,     0, 8,  GPENTH)                \
+    X(r, APDS9960_GEXTH,      0, 8,  GEXTH)                 \
+    X(r, APDS9960_GCONF1,     0, 8,  GCONF1)                \
+    X(r, APDS9960_GCONF2,     0, 3,  GWTIME)                \
+    X(r, APDS9960_GCONF2,     3, 2,  GLDRIVE)               \
+    X(r, APDS9960_GCONF2,     5, 2,  GGAIN)                 \
+    X(r, APDS9960_GOFFSET_U,  0, 8,  GOFFSET)               \
+    X(r, APDS9960_GPULSE,     0, 8,  GPULSE)                \
+    X(r, APDS9960_GCONF3,     0, 8,  GCONF3)                \
+    X(r, APDS9960_GCONF4,     1, 1,  GIEN)
+
+// APDS_INIT_* values not loaded by apds9960_open, X(r, name)
+// -- PPULSE_GEST: loaded by apds9960_gesture_enable
+#define INIT_RUNTIME(X, r) \
+    X(r, PPULSE_GEST)
+
+// Contribution of one field to the byte of register r
+#define INIT_FIELD_BYTE(r, reg, lsb, width, name) \
+    | ((((r) >= (reg)) && ((r) - (reg) < ((lsb) + (width) + 7) / 8)) ? \
+    (uint8_t)(((((unsigned long)APDS_INIT_##name & ((1UL << (width)) - 1)) \
+    << (lsb)) >> (8 * (((r) - (reg)) & 3))) & 0xFF) : 0)
+
+#define INIT_BYTE(r)    (0 INIT_FIELDS(INIT_FIELD_BYTE, r))
+
+#define INIT_FIELD_CHECK(r, reg, lsb, width, name) \
+    _Static_assert(((unsigned long)APDS_INIT_##name >> (width)) == 0, \
+        "APDS_INIT_" #name " does not fit its register field"); \
+    _Static_assert(REG_IS_SHADOWED(reg) && \
+        REG_IS_SHADOWED((reg) + ((lsb) + (width) - 1) / 8), \
+        "APDS_INIT_" #name " is not in an init table run");
+
+// Every default must be loaded by the table or applied at runtime
+#define INIT_ID(name, value)            INIT_ID_##name,
+#define INIT_FIELD_USE(r, reg, lsb, width, name)    + (INIT_ID_##name == r)
+#define INIT_RUNTIME_USE(r, name)                   + (INIT_ID_##name == r)
+#define INIT_DEFAULT_CHECK(name, value) \
+    _Static_assert((0 INIT_FIELDS(INIT_FIELD_USE, INIT_ID_##name) \
+        INIT_RUNTIME(INIT_RUNTIME_USE, INIT_ID_##name)) == 1, \
+        "APDS_INIT_" #name " must be in INIT_FIELDS or INIT_RUNTIME once");
+
+#define INIT_IMAGE(reg) [(reg) - APDS9960_SHADOW_FIRST] = INIT_BYTE(reg)
+
+enum {
+    APDS_INIT_DEFAULTS(INIT_ID)
+};
+
+INIT_FIELDS(INIT_FIELD_CHECK, 0)
+APDS_INIT_DEFAULTS(INIT_DEFAULT_CHECK)
+
+// Auto-increment register run
+typedef struct
+{
+    uint8_t first;
+    uint8_t last;
+} reg_run_t;
+
 /*******************************************************************************
 * Forward declarations of private functions
 *******************************************************************************/
@@ -31,6 +103,53 @@
 * Global variables
 *******************************************************************************/
 
+// Register image loaded by apds9960_open, indexed from APDS9960_SHADOW_FIRST
+// ENABLE is written as 0 first: all functions disabled, power off
+static const uint8_t init_image[APDS9960_SHADOW_SIZE] = {
+    [APDS9960_ENABLE - APDS9960_SHADOW_FIRST] = 0,
+    INIT_IMAGE(APDS9960_ATIME),
+    INIT_IMAGE(APDS9960_WTIME),
+    INIT_IMAGE(APDS9960_AILTL),
+    INIT_IMAGE(APDS9960_AILTH),
+    INIT_IMAGE(APDS9960_AIHTL),
+    INIT_IMAGE(APDS9960_AIHTH),
+    INIT_IMAGE(APDS9960_PILT),
+    INIT_IMAGE(APDS9960_PIHT),
+    INIT_IMAGE(APDS9960_PERS),
+    INIT_IMAGE(APDS9960_CONFIG1),
+    INIT_IMAGE(APDS9960_PPULSE),
+    INIT_IMAGE(APDS9960_CONTROL),
+    INIT_IMAGE(APDS9960_CONFIG2),
+    INIT_IMAGE(APDS9960_POFFSET_UR),
+    INIT_IMAGE(APDS9960_POFFSET_DL),
+    INIT_IMAGE(APDS9960_CONFIG3),
+    INIT_IMAGE(APDS9960_GPENTH),
+    INIT_IMAGE(APDS9960_GEXTH),
+    INIT_IMAGE(APDS9960_GCONF1),
+    INIT_IMAGE(APDS9960_GCONF2),
+    INIT_IMAGE(APDS9960_GOFFSET_U),
+    // GOFFSET_D, GOFFSET_L, GOFFSET_R share APDS_INIT_GOFFSET
+    [APDS9960_GOFFSET_D - APDS9960_SHADOW_FIRST] = INIT_BYTE(APDS9960_GOFFSET_U),
+    INIT_IMAGE(APDS9960_GPULSE),
+    [APDS9960_GOFFSET_L - APDS9960_SHADOW_FIRST] = INIT_BYTE(APDS9960_GOFFSET_U),
+    [APDS9960_GOFFSET_R - APDS9960_SHADOW_FIRST] = INIT_BYTE(APDS9960_GOFFSET_U),
+    INIT_IMAGE(APDS9960_GCONF3),
+    INIT_IMAGE(APDS9960_GCONF4)
+};
+
+// Init image is written in these auto-increment runs, reserved registers
+// 0x82, 0x88, 0x8A and 0xA8 are skipped
+static const reg_run_t init_runs[] = {
+    { APDS9960_ENABLE,      APDS9960_ATIME },       // 0x80 - 0x81
+    { APDS9960_WTIME,       APDS9960_AIHTH },       // 0x83 - 0x87
+    { APDS9960_PILT,        APDS9960_PILT },        // 0x89
+    { APDS9960_PIHT,        APDS9960_CONFIG2 },     // 0x8B - 0x90
+    { APDS9960_POFFSET_UR,  APDS9960_GOFFSET_L },   // 0x9D - 0xA7
+    { APDS9960_GOFFSET_R,   APDS9960_GCONF4 }       // 0xA9 - 0xAB
+};
+
+#define INIT_RUN_COUNT  (sizeof(init_runs) / sizeof(init_runs[0]))
+
 
 /*******************************************************************************
 * Function definitions
@@ -38,11 +157,24 @@
 
 apds9960_t 
 *apds9960_open(int i2c_fd, I2C_DeviceAddress i2c_addr)
+{
+    return apds9960_open_transport(APDS9960_TRANSPORT_DEFAULT, NULL, i2c_fd,
+        i2c_addr);
+}
+
+apds9960_t
+*apds9960_open_transport(const apds9960_transport_t *p_transport,
+    void *p_transport_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr)
 {
     apds9960_t *p_apds = NULL;
     bool is_init_ok = true;
 
-    if ((p_apds = malloc(sizeof(apds9960_t))) == NULL)
+    if (!p_transport)
+    {
+        is_init_ok = false;
+        ERROR("No bus transport given.", __FUNCTION__);
+    }
+    else if ((p_apds = malloc(sizeof(apds9960_t))) == NULL)
     {
         // Cannot allocate memory for device descriptor
         is_init_ok = false;
@@ -52,8 +184,13 @@ apds9960_t
     // Initialize device descriptor, check device ID
     if (is_init_ok)
     {
+        memset(p_apds, 0, sizeof(apds9960_t));
         p_apds->i2c_fd = i2c_fd;
         p_apds->i2c_addr = i2c_addr;
+        p_apds->p_transport = p_transport;
+        p_apds->p_transport_ctx = p_transport_ctx;
+        p_apds->gesture_fifo_chunk = APDS9960_GFIFO_CHUNK_DEFAULT;
+        apds9960_gesture_decoder_init(&p_apds->gesture_decoder, NULL);
 
         // Check device hardware ID
         DEBUG_DEV("--- Checking hardware ID", __FUNCTION__, p_apds);
@@ -75,218 +212,13 @@ apds9960_t
     }
 
     // Reload initial values
-    uint8_t reg_byte;
-
-    if (is_init_ok)
-    {
-        // ENABLE: Disable all functions, power off
-        reg_byte = 0;
-        is_init_ok = reg_write8(p_apds, APDS9960_ENABLE, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // ATIME: 103 ms
-        reg_byte = APDS_INIT_ATIME;
-        is_init_ok = reg_write8(p_apds, APDS9960_ATIME, &reg_byte);
-    }
-
-    if (is_init_ok)
+    for (size_t idx = 0; is_init_ok && (idx < INIT_RUN_COUNT); idx++)
     {
-        // WTIME: 27 ms
-        reg_byte = APDS_INIT_WTIME;
-        is_init_ok = reg_write8(p_apds, APDS9960_WTIME, &reg_byte);
-    }
+        const reg_run_t *p_run = &init_runs[idx];
 
-    if (is_init_ok)
-    {
-        // PPULSE: 16us, 8 pulses, optimized for proximity engine
-        reg_byte = APDS_INIT_PPULSE_PROX;
-        is_init_ok = reg_write8(p_apds, APDS9960_PPULSE, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // POFFSET_UR: 0
-        reg_byte = APDS_INIT_POFFSET_UR;
-        is_init_ok = reg_write8(p_apds, APDS9960_POFFSET_UR, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // POFFSET_DL: 0
-        reg_byte = APDS_INIT_POFFSET_DL;
-        is_init_ok = reg_write8(p_apds, APDS9960_POFFSET_DL, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // CONFIG1: No 12x wait (WTIME) factor
-        reg_byte = APDS_INIT_CONFIG1;
-        is_init_ok = reg_write8(p_apds, APDS9960_CONFIG1, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // CONTROL: 
-        // -- LDRIVE: LED Current 100 mA
-        // -- PGAIN: 4x
-        // -- AGAIN: 4x
-        apds9960_control_t reg_control;
-        is_init_ok = reg_read8(p_apds, APDS9960_CONTROL, &reg_control.byte);
-        if (is_init_ok)
-        {
-            reg_control.LDRIVE = APDS_INIT_LDRIVE;
-            reg_control.PGAIN = APDS_INIT_PGAIN;
-            reg_control.AGAIN = APDS_INIT_AGAIN;
-            is_init_ok = reg_write8(p_apds, APDS9960_CONTROL, &reg_control.byte);
-        }
-    }
-
-    if (is_init_ok)
-    {
-        // PILT: 0
-        reg_byte = APDS_INIT_PILT;
-        is_init_ok = reg_write8(p_apds, APDS9960_PILT, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // PIHT: 50
-        reg_byte = APDS_INIT_PIHT;
-        is_init_ok = reg_write8(p_apds, APDS9960_PIHT, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // AILT: 0xFFFF
-        reg_byte = (uint8_t) (APDS_INIT_AILT & 0xFF);
-        is_init_ok = reg_write8(p_apds, APDS9960_AILTL, &reg_byte);
-        if (is_init_ok)
-        {
-            reg_byte = (uint8_t) (APDS_INIT_AILT >> 8);
-            is_init_ok = reg_write8(p_apds, APDS9960_AILTH, &reg_byte);
-        }
-    }
-
-    if (is_init_ok)
-    {
-        // AIHT: 0
-        reg_byte = (uint8_t) (APDS_INIT_AIHT & 0xFF);
-        is_init_ok = reg_write8(p_apds, APDS9960_AIHTL, &reg_byte);
-        if (is_init_ok)
-        {
-            reg_byte = (uint8_t)(APDS_INIT_AIHT >> 8);
-            is_init_ok = reg_write8(p_apds, APDS9960_AIHTH, &reg_byte);
-        }
-    }
-
-    if (is_init_ok)
-    {
-        // PERS: 2 consecutive prox or ALS for interrupt
-        reg_byte = APDS_INIT_PERS;
-        is_init_ok = reg_write8(p_apds, APDS9960_PERS, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // CONFIG2: No saturation interrupts or LED boost
-        reg_byte = APDS_INIT_CONFIG2;
-        is_init_ok = reg_write8(p_apds, APDS9960_CONFIG2, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // CONFIG3: Enable all photodiodes, no SAI
-        reg_byte = APDS_INIT_CONFIG3;
-        is_init_ok = reg_write8(p_apds, APDS9960_CONFIG3, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GPENTH: 40
-        reg_byte = APDS_INIT_GPENTH;
-        is_init_ok = reg_write8(p_apds, APDS9960_GPENTH, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GEXTH: 30
-        reg_byte = APDS_INIT_GEXTH;
-        is_init_ok = reg_write8(p_apds, APDS9960_GEXTH, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GCONF1: 4 events for interrupt, 1 for exit
-        reg_byte = APDS_INIT_GCONF1;
-        is_init_ok = reg_write8(p_apds, APDS9960_GCONF1, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GCONF2:
-        // -- GGAIN: 4x
-        // -- GLDRIVE: 100 mA
-        // -- GWTIME: 2.8 ms
-        apds9960_gconf2_t reg_gconf2;
-        is_init_ok = reg_read8(p_apds, APDS9960_GCONF2, &reg_gconf2.byte);
-        if (is_init_ok)
-        {
-            reg_gconf2.GGAIN = APDS_INIT_GGAIN;
-            reg_gconf2.GLDRIVE = APDS_INIT_GLDRIVE;
-            reg_gconf2.GWTIME = APDS_INIT_GWTIME;
-            is_init_ok = reg_write8(p_apds, APDS9960_GCONF2, &reg_gconf2.byte);
-        }
-    }
-
-    if (is_init_ok)
-    {
-        // GOFFSET_U, GOFFSET_D, GOFFSET_L, GOFFSET_R: 0
-        reg_byte = APDS_INIT_GOFFSET;
-        is_init_ok = reg_write8(p_apds, APDS9960_GOFFSET_U, &reg_byte);
-
-        if (is_init_ok)
-        {
-            is_init_ok = reg_write8(p_apds, APDS9960_GOFFSET_D, &reg_byte);
-        }
-
-        if (is_init_ok)
-        {
-            is_init_ok = reg_write8(p_apds, APDS9960_GOFFSET_L, &reg_byte);
-        }
-
-        if (is_init_ok)
-        {
-            is_init_ok = reg_write8(p_apds, APDS9960_GOFFSET_R, &reg_byte);
-        }
-    }
-
-    if (is_init_ok)
-    {
-        // GPULSE: 32 us, 10 pulses
-        reg_byte = APDS_INIT_GPULSE;
-        is_init_ok = reg_write8(p_apds, APDS9960_GPULSE, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GCONF3: All diodes active during gesture
-        reg_byte = APDS_INIT_GCONF3;
-        is_init_ok = reg_write8(p_apds, APDS9960_GCONF3, &reg_byte);
-    }
-
-    if (is_init_ok)
-    {
-        // GCONF4:
-        // -- GIEN: 0
-        apds9960_gconf4_t reg_gconf4;
-        is_init_ok = reg_read8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-        if (is_init_ok)
-        {
-            reg_gconf4.GIEN = APDS_INIT_GIEN;
-            is_init_ok = reg_write8(p_apds, APDS9960_GCONF4, &reg_gconf4.byte);
-        }
+        is_init_ok = (reg_write(p_apds, p_run->first,
+            &init_image[p_run->first - APDS9960_SHADOW_FIRST],
+            (uint32_t)(p_run->last - p_run->first + 1)) != -1);
     }
 
     if (!is_init_ok)
@@ -316,6 +248,38 @@ apds9960_close(apds9960_t *p_apds)
     free(p_apds);
 }
 
+bool
+apds9960_shadow_resync(apds9960_t *p_apds)
+{
+    bool b_is_all_ok = false;
+    uint8_t *p_shadow = p_apds->reg_shadow;
+
+    // Two bursts cover both writable register ranges
+    b_is_all_ok = (reg_read(p_apds, APDS9960_ENABLE,
+        &p_shadow[APDS9960_ENABLE - APDS9960_SHADOW_FIRST],
+        APDS9960_CONFIG2 - APDS9960_ENABLE + 1) != -1);
+
+    if (b_is_all_ok)
+    {
+        b_is_all_ok = (reg_read(p_apds, APDS9960_POFFSET_UR,
+            &p_shadow[APDS9960_POFFSET_UR - APDS9960_SHADOW_FIRST],
+            APDS9960_GCONF4 - APDS9960_POFFSET_UR + 1) != -1);
+    }
+
+    if (!b_is_all_ok)
+    {
+        ERROR("Error reading register shadow.", __FUNCTION__);
+    }
+
+    return b_is_all_ok;
+}
+
+void
+apds9960_config_default(apds9960_config_t *p_config)
+{
+    config_from_image(init_image, p_config);
+}
+
 /*******************************************************************************
 * Private function definitions
 *******************************************************************************/
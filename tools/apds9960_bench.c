@@ -0,0 +1,504 @@
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_sim.h"
+
+#define BENCH_ITERATIONS_DEFAULT    100
+#define BENCH_SWIPE_FRAMES          17
+#define BENCH_RESULTS_MAX           32
+
+// I2C bit counts: START or repeated START, address byte + ACK, data byte + ACK
+#define I2C_BITS_START      1
+#define I2C_BITS_STOP       1
+#define I2C_BITS_BYTE       9
+
+// Transport wrapper counting bus activity of the wrapped transport
+typedef struct
+{
+    const apds9960_transport_t *p_transport;
+    void *p_transport_ctx;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint64_t bits;
+} bench_counter_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t calls;
+    uint32_t failures;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint64_t bits;
+    int64_t wall_ns;
+} bench_result_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Start measuring one call of a library operation.
+ *
+ * Calls of the same name accumulate into one result record.
+ *
+ * @param p_name Operation name used in report.
+ *
+ * @return Pointer to result record or NULL if results table is full.
+ */
+static bench_result_t
+*bench_begin(const char *p_name);
+
+static void
+bench_end(bench_result_t *p_result, bool b_is_ok);
+
+static void
+bench_run_all(apds9960_sim_t *p_sim, int i2c_fd, uint32_t iterations);
+
+static void
+bench_run_gesture(apds9960_sim_t *p_sim);
+
+static int
+bench_report(FILE *p_file);
+
+static ssize_t
+counter_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len);
+
+static ssize_t
+counter_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len);
+
+static ssize_t
+counter_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len);
+
+static ssize_t
+counter_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count);
+
+static void
+counter_add(size_t msg_count, size_t data_len);
+
+static uint64_t
+bus_time_ns(uint64_t bits, uint32_t bus_hz);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const apds9960_transport_t counter_transport = {
+    .name = "counter",
+    .read = counter_read,
+    .write = counter_write,
+    .write_then_read = counter_write_then_read,
+    .transfer = counter_transfer
+};
+
+static bench_counter_t counter;
+static apds9960_t *p_apds = NULL;
+
+static bench_result_t results[BENCH_RESULTS_MAX];
+static uint32_t result_count = 0;
+
+static struct timespec bench_start;
+static bench_counter_t bench_counter_start;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    const char *p_out_path = NULL;
+    uint32_t iterations = BENCH_ITERATIONS_DEFAULT;
+    int bus_number = -1;
+    int i2c_fd = -1;
+    int opt;
+    int result = EXIT_FAILURE;
+    FILE *p_out = stdout;
+    apds9960_sim_t *p_sim = NULL;
+
+    while ((opt = getopt(argc, argv, "b:n:o:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                bus_number = atoi(optarg);
+                break;
+
+            case 'n':
+                iterations = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+
+            case 'o':
+                p_out_path = optarg;
+                break;
+
+            default:
+                fprintf(stderr,
+                    "Usage: %s [-b i2c_bus] [-n iterations] [-o results.csv]\n"
+                    "Runs against the simulator unless an I2C bus is given.\n",
+                    argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (iterations == 0)
+    {
+        iterations = 1;
+    }
+
+    // Simulated device runs in real time so blocking calls work unchanged
+    if (bus_number < 0)
+    {
+        p_sim = apds9960_sim_open(false);
+        counter.p_transport = &apds9960_transport_sim;
+        counter.p_transport_ctx = p_sim;
+    }
+    else
+    {
+        i2c_fd = apds9960_i2cdev_open((unsigned int)bus_number);
+        counter.p_transport = &apds9960_transport_i2cdev;
+        counter.p_transport_ctx = NULL;
+    }
+
+    if ((p_sim != NULL) || (i2c_fd != -1))
+    {
+        bench_run_all(p_sim, i2c_fd, iterations);
+
+        if (p_out_path)
+        {
+            p_out = fopen(p_out_path, "w");
+        }
+
+        if (p_out)
+        {
+            result = bench_report(p_out);
+
+            if (p_out != stdout)
+            {
+                fclose(p_out);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Cannot open %s: %s\n", p_out_path,
+                strerror(errno));
+        }
+    }
+
+    if (i2c_fd != -1)
+    {
+        close(i2c_fd);
+    }
+    apds9960_sim_close(p_sim);
+
+    return result;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bench_result_t
+*bench_begin(const char *p_name)
+{
+    bench_result_t *p_result = NULL;
+
+    for (uint32_t idx = 0; idx < result_count; idx++)
+    {
+        if (strcmp(results[idx].name, p_name) == 0)
+        {
+            p_result = &results[idx];
+        }
+    }
+
+    if ((p_result == NULL) && (result_count < BENCH_RESULTS_MAX))
+    {
+        p_result = &results[result_count++];
+        memset(p_result, 0, sizeof(bench_result_t));
+        p_result->name = p_name;
+    }
+
+    bench_counter_start = counter;
+    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+
+    return p_result;
+}
+
+static void
+bench_end(bench_result_t *p_result, bool b_is_ok)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (p_result)
+    {
+        p_result->calls++;
+        p_result->failures += b_is_ok ? 0 : 1;
+        p_result->wall_ns += (now.tv_sec - bench_start.tv_sec) * 1000000000LL +
+            (now.tv_nsec - bench_start.tv_nsec);
+        p_result->transactions +=
+            counter.transactions - bench_counter_start.transactions;
+        p_result->bytes += counter.bytes - bench_counter_start.bytes;
+        p_result->bits += counter.bits - bench_counter_start.bits;
+    }
+}
+
+// Measure expression, evaluating to true on success
+#define BENCH(name, expr) \
+    do { \
+        bench_result_t *p_res = bench_begin(name); \
+        bool b_res = (expr); \
+        bench_end(p_res, b_res); \
+    } while (0)
+
+static void
+bench_run_all(apds9960_sim_t *p_sim, int i2c_fd, uint32_t iterations)
+{
+    uint16_t value16;
+    uint8_t value8;
+    bool b_value;
+    apds9960_rgbc_t rgbc;
+    apds9960_sample_t sample;
+    apds9960_gesture_event_t events[APDS9960_GESTURE_EVENTS_MAX];
+    struct timespec deadline;
+
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        if (p_apds)
+        {
+            apds9960_close(p_apds);
+        }
+        BENCH("apds9960_open", (p_apds = apds9960_open_transport(
+            &counter_transport, &counter, i2c_fd, APDS9960_I2C_ADDRESS)) != NULL);
+    }
+
+    if (p_apds == NULL)
+    {
+        fprintf(stderr, "Cannot open device.\n");
+        return;
+    }
+
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        BENCH("apds9960_shadow_resync", apds9960_shadow_resync(p_apds));
+        BENCH("apds9960_als_enable", apds9960_als_enable(p_apds, false));
+        BENCH("apds9960_als_disable", apds9960_als_disable(p_apds));
+        BENCH("apds9960_proximity_enable", apds9960_proximity_enable(p_apds, false));
+        BENCH("apds9960_proximity_disable", apds9960_proximity_disable(p_apds));
+        BENCH("apds9960_gesture_enable", apds9960_gesture_enable(p_apds, false));
+        BENCH("apds9960_gesture_disable", apds9960_gesture_disable(p_apds));
+    }
+
+    // Data reads with the related engine running
+    apds9960_als_enable(p_apds, false);
+    apds9960_proximity_enable(p_apds, false);
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        BENCH("apds9960_als_read_rgbc", apds9960_als_read_rgbc(p_apds, &rgbc));
+        BENCH("apds9960_als_read_clear", apds9960_als_read_clear(p_apds, &value16));
+        BENCH("apds9960_als_read_red", apds9960_als_read_red(p_apds, &value16));
+        BENCH("apds9960_als_read_green", apds9960_als_read_green(p_apds, &value16));
+        BENCH("apds9960_als_read_blue", apds9960_als_read_blue(p_apds, &value16));
+        BENCH("apds9960_proximity_read", apds9960_proximity_read(p_apds, &value8));
+        BENCH("apds9960_read_all", apds9960_read_all(p_apds, &sample));
+        BENCH("apds9960_service_interrupt",
+            apds9960_service_interrupt(p_apds, &deadline));
+        BENCH("apds9960_gesture_is_valid", apds9960_gesture_is_valid(p_apds, &b_value));
+        BENCH("apds9960_gesture_set_fifo_chunk",
+            apds9960_gesture_set_fifo_chunk(p_apds, APDS9960_GFIFO_CHUNK_DEFAULT));
+        BENCH("apds9960_gesture_events_read",
+            apds9960_gesture_events_read(p_apds, events, APDS9960_GESTURE_EVENTS_MAX) == 0);
+    }
+    apds9960_proximity_disable(p_apds);
+    apds9960_als_disable(p_apds);
+
+    // Idle poll step with gesture engine on and no hand in the field
+    apds9960_gesture_enable(p_apds, false);
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        BENCH("apds9960_gesture_poll",
+            apds9960_gesture_poll(p_apds, NULL, &deadline) != -1);
+    }
+    apds9960_gesture_disable(p_apds);
+
+    if (p_sim)
+    {
+        bench_run_gesture(p_sim);
+
+        // Self-test needs FIFO data, scripted as a hand held still
+        apds9960_sim_frame_t hover = { 0, { 0, 0, 0, 0 }, { 80, 80, 80, 80 } };
+        apds9960_sim_load_script(p_sim, &hover, 1, false);
+        BENCH("apds9960_gesture_fifo_selftest",
+            apds9960_gesture_fifo_selftest(p_apds, &value8));
+        apds9960_sim_load_script(p_sim, NULL, 0, false);
+    }
+
+    for (uint32_t iter = 0; iter < iterations; iter++)
+    {
+        BENCH("apds9960_close", (apds9960_close(p_apds), true));
+        p_apds = apds9960_open_transport(&counter_transport, &counter, i2c_fd,
+            APDS9960_I2C_ADDRESS);
+    }
+    apds9960_close(p_apds);
+    p_apds = NULL;
+}
+
+static void
+bench_run_gesture(apds9960_sim_t *p_sim)
+{
+    const struct timespec POLL_DELAY = { 0, 5 * 1000000 };
+    const struct timespec HAND_DELAY = { 0, 100 * 1000000 };
+
+    static const int DIRECTIONS[] = {
+        GESTURE_DIR_LEFT, GESTURE_DIR_RIGHT, GESTURE_DIR_UP, GESTURE_DIR_DOWN
+    };
+
+    apds9960_sim_frame_t frames[BENCH_SWIPE_FRAMES];
+    bool b_is_valid = false;
+    int gesture;
+
+    // One full swipe per direction, measured from GVALID to decoded gesture
+    for (size_t idx = 0; idx < sizeof(DIRECTIONS) / sizeof(DIRECTIONS[0]); idx++)
+    {
+        size_t count = apds9960_sim_script_swipe(frames, BENCH_SWIPE_FRAMES,
+            50, 300, DIRECTIONS[idx], 200);
+
+        apds9960_gesture_enable(p_apds, false);
+        apds9960_sim_load_script(p_sim, frames, count, false);
+
+        // Gesture mode forced on by enable fills FIFO before the hand
+        // arrives, start reading with the hand in the field
+        nanosleep(&HAND_DELAY, NULL);
+
+        b_is_valid = false;
+        for (int wait = 0; (wait < 100) && !b_is_valid; wait++)
+        {
+            nanosleep(&POLL_DELAY, NULL);
+            apds9960_gesture_is_valid(p_apds, &b_is_valid);
+        }
+
+        BENCH("apds9960_gesture_read",
+            (gesture = apds9960_gesture_read(p_apds)) == DIRECTIONS[idx]);
+
+        if (gesture != DIRECTIONS[idx])
+        {
+            fprintf(stderr, "Swipe %d decoded as %d.\n", DIRECTIONS[idx],
+                gesture);
+        }
+
+        apds9960_gesture_disable(p_apds);
+    }
+
+    apds9960_sim_load_script(p_sim, NULL, 0, false);
+}
+
+static int
+bench_report(FILE *p_file)
+{
+    int result = EXIT_SUCCESS;
+
+    // Per-call averages, bus times exclude clock stretching and bus gaps
+    fprintf(p_file, "api,calls,failures,transactions,bytes,wall_us,"
+        "bus_us_100khz,bus_us_400khz\n");
+
+    for (uint32_t idx = 0; idx < result_count; idx++)
+    {
+        const bench_result_t *p_res = &results[idx];
+        double calls = p_res->calls;
+
+        fprintf(p_file, "%s,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+            p_res->name, p_res->calls, p_res->failures,
+            p_res->transactions / calls, p_res->bytes / calls,
+            p_res->wall_ns / calls / 1000.0,
+            bus_time_ns(p_res->bits, 100000) / calls / 1000.0,
+            bus_time_ns(p_res->bits, 400000) / calls / 1000.0);
+
+        if (p_res->failures > 0)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+
+    return result;
+}
+
+static ssize_t
+counter_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    uint8_t *p_data, size_t data_len)
+{
+    bench_counter_t *p_counter = (bench_counter_t *)p_ctx;
+
+    counter_add(1, data_len);
+    return p_counter->p_transport->read(p_counter->p_transport_ctx, i2c_fd,
+        i2c_addr, p_data, data_len);
+}
+
+static ssize_t
+counter_write(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_data, size_t data_len)
+{
+    bench_counter_t *p_counter = (bench_counter_t *)p_ctx;
+
+    counter_add(1, data_len);
+    return p_counter->p_transport->write(p_counter->p_transport_ctx, i2c_fd,
+        i2c_addr, p_data, data_len);
+}
+
+static ssize_t
+counter_write_then_read(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    const uint8_t *p_wr_data, size_t wr_len, uint8_t *p_rd_data,
+    size_t rd_len)
+{
+    bench_counter_t *p_counter = (bench_counter_t *)p_ctx;
+
+    counter_add(2, wr_len + rd_len);
+    return p_counter->p_transport->write_then_read(p_counter->p_transport_ctx,
+        i2c_fd, i2c_addr, p_wr_data, wr_len, p_rd_data, rd_len);
+}
+
+static ssize_t
+counter_transfer(void *p_ctx, int i2c_fd, I2C_DeviceAddress i2c_addr,
+    apds9960_i2c_msg_t *p_msgs, size_t msg_count)
+{
+    bench_counter_t *p_counter = (bench_counter_t *)p_ctx;
+    size_t data_len = 0;
+
+    for (size_t idx = 0; idx < msg_count; idx++)
+    {
+        data_len += p_msgs[idx].len;
+    }
+
+    counter_add(msg_count, data_len);
+    return p_counter->p_transport->transfer(p_counter->p_transport_ctx, i2c_fd,
+        i2c_addr, p_msgs, msg_count);
+}
+
+static void
+counter_add(size_t msg_count, size_t data_len)
+{
+    // One transaction, every message starts with (repeated) START and address
+    counter.transactions++;
+    counter.bytes += (uint32_t)data_len;
+    counter.bits += msg_count * (I2C_BITS_START + I2C_BITS_BYTE) +
+        data_len * I2C_BITS_BYTE + I2C_BITS_STOP;
+}
+
+static uint64_t
+bus_time_ns(uint64_t bits, uint32_t bus_hz)
+{
+    return (bits * 1000000000ULL) / bus_hz;
+}
+
+/* [] END OF FILE */
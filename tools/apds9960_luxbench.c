@@ -0,0 +1,394 @@
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_lux.h"
+
+#define LUXBENCH_SAMPLES            4096    // Distinct samples, fit in cache
+#define LUXBENCH_CONVERSIONS        4000000
+#define LUXBENCH_RANGE_RUN          64      // Samples per ALS range
+
+// Sample with range it was taken with
+typedef struct
+{
+    apds9960_rgbc_t rgbc;
+    uint8_t als_gain;
+    uint32_t als_time_us;
+} luxbench_sample_t;
+
+typedef struct
+{
+    const char *name;
+    double ns;
+    uint64_t cycles;    // 0 when cycle counter is not available
+} luxbench_result_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Floating-point reference of apds9960_lux_compute().
+ *
+ * Same equations as the fixed-point engine, as typically written by
+ * application code.
+ *
+ * @param p_cal Calibration.
+ * @param p_sample Sample to convert.
+ * @param p_lux Illuminance in lux.
+ * @param p_cct Colour temperature in kelvin, 0 if not determined.
+ */
+static void
+lux_reference(const apds9960_lux_cal_t *p_cal, const luxbench_sample_t *p_sample,
+    double *p_lux, double *p_cct);
+
+/**
+ * @brief Generate samples from pseudo-random light across ALS ranges.
+ *
+ * Consecutive runs of LUXBENCH_RANGE_RUN samples share a range, as with
+ * auto-ranging.
+ *
+ * @param p_samples Samples to fill.
+ * @param count Number of samples.
+ */
+static void
+luxbench_generate(luxbench_sample_t *p_samples, size_t count);
+
+static void
+luxbench_run_fixed(const luxbench_sample_t *p_samples, uint32_t conversions,
+    luxbench_result_t *p_result);
+
+static void
+luxbench_run_float(const luxbench_sample_t *p_samples, uint32_t conversions,
+    luxbench_result_t *p_result);
+
+static void
+luxbench_accuracy(const luxbench_sample_t *p_samples, size_t count);
+
+static int
+cycles_open(void);
+
+static uint64_t
+cycles_read(int fd);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static luxbench_sample_t samples[LUXBENCH_SAMPLES];
+
+// Results are summed so that conversions are not optimized out
+static volatile uint64_t sink;
+
+static int cycles_fd = -1;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    uint32_t conversions = LUXBENCH_CONVERSIONS;
+    double cpu_mhz = 0;
+    luxbench_result_t results[2];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                conversions = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+
+            case 'f':
+                cpu_mhz = atof(optarg);
+                break;
+
+            default:
+                fprintf(stderr,
+                    "Usage: %s [-n conversions] [-f cpu_mhz]\n"
+                    "Times fixed-point lux/CCT conversion against a floating-"
+                    "point reference.\nCycles come from the CPU cycle counter, "
+                    "-f estimates them from time when\nthe counter is not "
+                    "available.\n", argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (conversions == 0)
+    {
+        conversions = 1;
+    }
+
+    luxbench_generate(samples, LUXBENCH_SAMPLES);
+    luxbench_accuracy(samples, LUXBENCH_SAMPLES);
+
+    cycles_fd = cycles_open();
+
+    luxbench_run_fixed(samples, conversions, &results[0]);
+    luxbench_run_float(samples, conversions, &results[1]);
+
+    for (int idx = 0; idx < 2; idx++)
+    {
+        double cycles = (double)results[idx].cycles / conversions;
+
+        if ((results[idx].cycles == 0) && (cpu_mhz > 0))
+        {
+            cycles = results[idx].ns * cpu_mhz / 1000.0 / conversions;
+        }
+
+        printf("%-6s %u conversions, %.2f ns/conversion", results[idx].name,
+            conversions, results[idx].ns / conversions);
+
+        if (cycles > 0)
+        {
+            printf(", %.1f cycles/conversion%s", cycles,
+                (results[idx].cycles == 0) ? " (estimated)" : "");
+        }
+        printf("\n");
+    }
+
+    if (cycles_fd != -1)
+    {
+        close(cycles_fd);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+lux_reference(const apds9960_lux_cal_t *p_cal, const luxbench_sample_t *p_sample,
+    double *p_lux, double *p_cct)
+{
+    const apds9960_rgbc_t *p_rgbc = &p_sample->rgbc;
+    double ir = (p_rgbc->red + p_rgbc->green + p_rgbc->blue -
+        (double)p_rgbc->clear) / 2.0;
+
+    if (ir < 0)
+    {
+        ir = 0;
+    }
+
+    // Integer engine truncates IR as well
+    ir = (double)(int)ir;
+
+    double red = p_rgbc->red - ir;
+    double green = p_rgbc->green - ir;
+    double blue = p_rgbc->blue - ir;
+    double cpl = (p_sample->als_time_us / 1000.0) * p_sample->als_gain /
+        ((p_cal->ga_milli / 1000.0) * p_cal->df);
+    double lux = (p_cal->r_coef_milli * red + p_cal->g_coef_milli * green +
+        p_cal->b_coef_milli * blue) / 1000.0 / cpl;
+
+    *p_lux = (lux > 0) ? lux : 0;
+    *p_cct = (red > 0) ? p_cal->ct_coef * blue / red + p_cal->ct_offset : 0;
+}
+
+static void
+luxbench_generate(luxbench_sample_t *p_samples, size_t count)
+{
+    srand(1);
+
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        luxbench_sample_t *p_sample = &p_samples[idx];
+
+        if (idx % LUXBENCH_RANGE_RUN == 0)
+        {
+            p_sample->als_gain = (uint8_t)(1 << (2 * (rand() % 4)));
+            p_sample->als_time_us = (uint32_t)(1 + rand() % 256) *
+                APDS9960_ALS_CYCLE_US;
+        }
+        else
+        {
+            p_sample->als_gain = p_samples[idx - 1].als_gain;
+            p_sample->als_time_us = p_samples[idx - 1].als_time_us;
+        }
+
+        // Warm to cold light, IR share up to a third of clear
+        uint32_t cycles = p_sample->als_time_us / APDS9960_ALS_CYCLE_US;
+        uint32_t full_scale = cycles * APDS9960_ALS_CYCLE_COUNTS;
+        uint32_t clear = (uint32_t)rand() % ((full_scale > 0xFFFF) ?
+            0xFFFF : full_scale);
+        uint32_t ir = clear * (uint32_t)(rand() % 34) / 100;
+        uint32_t visible = clear - ir;
+        uint32_t red_pct = 25 + (uint32_t)(rand() % 20);
+        uint32_t blue_pct = 15 + (uint32_t)(rand() % 20);
+
+        p_sample->rgbc.clear = (uint16_t)clear;
+        p_sample->rgbc.red = (uint16_t)(visible * red_pct / 100 + ir);
+        p_sample->rgbc.blue = (uint16_t)(visible * blue_pct / 100 + ir);
+        p_sample->rgbc.green = (uint16_t)(visible *
+            (100 - red_pct - blue_pct) / 100 + ir);
+    }
+}
+
+static void
+luxbench_run_fixed(const luxbench_sample_t *p_samples, uint32_t conversions,
+    luxbench_result_t *p_result)
+{
+    apds9960_lux_t lux;
+    apds9960_light_t light;
+    struct timespec start;
+    struct timespec end;
+    uint64_t sum = 0;
+    uint64_t cycles_start;
+
+    apds9960_lux_init(&lux, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cycles_start = cycles_read(cycles_fd);
+
+    for (uint32_t idx = 0; idx < conversions; idx++)
+    {
+        const luxbench_sample_t *p_sample =
+            &p_samples[idx % LUXBENCH_SAMPLES];
+
+        apds9960_lux_compute(&lux, &p_sample->rgbc, p_sample->als_gain,
+            p_sample->als_time_us, &light);
+        sum += light.lux_milli + light.cct;
+    }
+
+    p_result->cycles = cycles_read(cycles_fd) - cycles_start;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    p_result->name = "fixed";
+    p_result->ns = (end.tv_sec - start.tv_sec) * 1e9 +
+        (end.tv_nsec - start.tv_nsec);
+    sink = sum;
+}
+
+static void
+luxbench_run_float(const luxbench_sample_t *p_samples, uint32_t conversions,
+    luxbench_result_t *p_result)
+{
+    apds9960_lux_cal_t cal;
+    struct timespec start;
+    struct timespec end;
+    double sum = 0;
+    double lux;
+    double cct;
+    uint64_t cycles_start;
+
+    apds9960_lux_cal_default(&cal);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cycles_start = cycles_read(cycles_fd);
+
+    for (uint32_t idx = 0; idx < conversions; idx++)
+    {
+        lux_reference(&cal, &p_samples[idx % LUXBENCH_SAMPLES], &lux, &cct);
+        sum += lux + cct;
+    }
+
+    p_result->cycles = cycles_read(cycles_fd) - cycles_start;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    p_result->name = "float";
+    p_result->ns = (end.tv_sec - start.tv_sec) * 1e9 +
+        (end.tv_nsec - start.tv_nsec);
+    sink = (uint64_t)sum;
+}
+
+static void
+luxbench_accuracy(const luxbench_sample_t *p_samples, size_t count)
+{
+    apds9960_lux_t lux;
+    apds9960_light_t light;
+    double max_lux_error = 0;
+    double max_cct_error = 0;
+    double ref_lux;
+    double ref_cct;
+
+    apds9960_lux_init(&lux, NULL);
+
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        apds9960_lux_compute(&lux, &p_samples[idx].rgbc,
+            p_samples[idx].als_gain, p_samples[idx].als_time_us, &light);
+        lux_reference(&lux.cal, &p_samples[idx], &ref_lux, &ref_cct);
+
+        // Errors below one milli-lux are rounding of the result itself
+        double lux_error = light.lux_milli / 1000.0 - ref_lux;
+        if ((lux_error < -0.001) || (lux_error > 0.001))
+        {
+            lux_error = (ref_lux > 0) ? lux_error / ref_lux : 1;
+            if (lux_error < 0)
+            {
+                lux_error = -lux_error;
+            }
+            if (lux_error > max_lux_error)
+            {
+                max_lux_error = lux_error;
+            }
+        }
+
+        double cct_error = (ref_cct > 0xFFFF) ? 0 : light.cct -
+            ((ref_cct < 0) ? 0 : ref_cct);
+        if (cct_error < 0)
+        {
+            cct_error = -cct_error;
+        }
+        if (cct_error > max_cct_error)
+        {
+            max_cct_error = cct_error;
+        }
+    }
+
+    printf("accuracy over %zu samples: max lux error %.4f %%, "
+        "max CCT error %.1f K\n", count, max_lux_error * 100, max_cct_error);
+}
+
+static int
+cycles_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // Count cycles of this thread on any CPU
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd == -1)
+    {
+        fprintf(stderr, "CPU cycle counter not available: %s\n",
+            strerror(errno));
+    }
+
+    return fd;
+}
+
+static uint64_t
+cycles_read(int fd)
+{
+    uint64_t count = 0;
+
+    if ((fd != -1) && (read(fd, &count, sizeof(count)) != sizeof(count)))
+    {
+        count = 0;
+    }
+
+    return count;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,398 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_sim.h"
+#include "apds9960_capture.h"
+#include "apds9960_irq.h"
+
+#define RECORD_POLL_MS          30      // Gesture poll period
+#define RECORD_IDLE_POLL_MS     10      // Poll period while no gesture active
+#define RECORD_SWIPE_FRAMES     17
+#define RECORD_SIM_SWIPES       25      // Default swipes per direction
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Record gestures from a live device.
+ *
+ * @param bus_number I2C bus of the sensor.
+ * @param seconds Recording duration.
+ * @param label Expected gesture of the whole recording or GESTURE_DIR_NONE.
+ * @param p_irq INT pin source, NULL polls the FIFO periodically.
+ * @param p_cap Capture writer.
+ *
+ * @return true on success.
+ */
+static bool
+record_live(int bus_number, uint32_t seconds, int label,
+    apds9960_irq_t *p_irq, apds9960_capture_t *p_cap);
+
+/**
+ * @brief Wait for INT assertion or gesture step deadline.
+ *
+ * @param p_irq INT pin source.
+ * @param p_now Current time.
+ * @param p_deadline Gesture step deadline, zero when no gesture is active.
+ * @param p_end Recording end.
+ *
+ * @return true on success.
+ */
+static bool
+record_wait_irq(apds9960_irq_t *p_irq, const struct timespec *p_now,
+    const struct timespec *p_deadline, const struct timespec *p_end);
+
+/**
+ * @brief Record scripted swipes from simulator, faster than real time.
+ *
+ * Swipe speed and strength vary pseudo-randomly, every swipe is labeled.
+ *
+ * @param swipes Number of swipes per direction.
+ * @param seed Pseudo-random generator seed.
+ * @param p_cap Capture writer.
+ *
+ * @return true on success.
+ */
+static bool
+record_sim(uint32_t swipes, unsigned int seed, apds9960_capture_t *p_cap);
+
+static int
+parse_direction(const char *p_name);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    const char *p_out_path = NULL;
+    char chip_path[64] = "";
+    unsigned int line_offset = 0;
+    int bus_number = -1;
+    uint32_t seconds = 10;
+    uint32_t swipes = RECORD_SIM_SWIPES;
+    unsigned int seed = 1;
+    int label = GESTURE_DIR_NONE;
+    int opt;
+    int fd;
+    bool b_is_all_ok = false;
+    apds9960_capture_t *p_cap;
+    apds9960_irq_t *p_irq = NULL;
+
+    while ((opt = getopt(argc, argv, "b:t:l:i:n:s:o:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                bus_number = atoi(optarg);
+                break;
+
+            case 't':
+                seconds = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+
+            case 'l':
+                label = parse_direction(optarg);
+                break;
+
+            case 'i':
+                if (sscanf(optarg, "%63[^:]:%u", chip_path, &line_offset) != 2)
+                {
+                    label = -1;
+                }
+                break;
+
+            case 'n':
+                swipes = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+
+            case 's':
+                seed = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+
+            case 'o':
+                p_out_path = optarg;
+                break;
+
+            default:
+                p_out_path = NULL;
+                break;
+        }
+    }
+
+    if ((p_out_path == NULL) || (label < 0))
+    {
+        fprintf(stderr,
+            "Usage: %s -o capture.agc [-b i2c_bus [-t seconds] "
+            "[-l left|right|up|down|near|far]\n"
+            "       [-i /dev/gpiochipN:line]] [-n swipes] [-s seed]\n"
+            "Records live device on given bus, otherwise labeled simulator "
+            "swipes.\nWith -i the FIFO is read on INT pin edges instead of "
+            "periodically.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (chip_path[0] != '\0')
+    {
+        p_irq = apds9960_irq_open_gpiod(chip_path, line_offset);
+        if (!p_irq)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    fd = open(p_out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", p_out_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    p_cap = apds9960_capture_open(fd);
+    if (p_cap)
+    {
+        if (bus_number >= 0)
+        {
+            b_is_all_ok = record_live(bus_number, seconds, label, p_irq, p_cap);
+        }
+        else
+        {
+            b_is_all_ok = record_sim(swipes, seed, p_cap);
+        }
+
+        b_is_all_ok = apds9960_capture_close(p_cap) && b_is_all_ok;
+    }
+
+    close(fd);
+    apds9960_irq_close(p_irq);
+
+    return b_is_all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+record_live(int bus_number, uint32_t seconds, int label,
+    apds9960_irq_t *p_irq, apds9960_capture_t *p_cap)
+{
+    struct timespec now;
+    struct timespec end;
+    struct timespec deadline;
+    struct timespec delay;
+    bool b_is_all_ok = false;
+    int gesture;
+
+    int i2c_fd = apds9960_i2cdev_open((unsigned int)bus_number);
+    apds9960_t *p_apds = NULL;
+
+    if (i2c_fd != -1)
+    {
+        p_apds = apds9960_open(i2c_fd, APDS9960_I2C_ADDRESS);
+    }
+
+    if (p_apds && apds9960_gesture_enable(p_apds, p_irq != NULL))
+    {
+        b_is_all_ok = apds9960_capture_config(p_cap, p_apds);
+        if (label != GESTURE_DIR_NONE)
+        {
+            b_is_all_ok = b_is_all_ok && apds9960_capture_label(p_cap, label);
+        }
+        apds9960_gesture_set_hook(p_apds, apds9960_capture_hook, p_cap);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        end.tv_sec += seconds;
+
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            gesture = apds9960_gesture_poll(p_apds, &now, &deadline);
+            if (gesture == -1)
+            {
+                b_is_all_ok = false;
+            }
+            else if (gesture != GESTURE_DIR_NONE)
+            {
+                printf("Gesture %d\n", gesture);
+            }
+
+            if (p_irq)
+            {
+                b_is_all_ok = b_is_all_ok &&
+                    record_wait_irq(p_irq, &now, &deadline, &end);
+            }
+            else
+            {
+                delay.tv_sec = 0;
+                delay.tv_nsec = (((deadline.tv_sec == 0) &&
+                    (deadline.tv_nsec == 0)) ? RECORD_IDLE_POLL_MS :
+                    RECORD_POLL_MS) * 1000000L;
+                nanosleep(&delay, NULL);
+            }
+        }
+        while (b_is_all_ok && ((now.tv_sec < end.tv_sec) ||
+            ((now.tv_sec == end.tv_sec) && (now.tv_nsec < end.tv_nsec))));
+
+        apds9960_gesture_set_hook(p_apds, NULL, NULL);
+        apds9960_gesture_disable(p_apds);
+
+        if (p_irq)
+        {
+            printf("INT wakeups %u, interrupts %u\n", p_irq->wakeups,
+                p_irq->interrupts);
+        }
+    }
+
+    if (p_apds)
+    {
+        apds9960_close(p_apds);
+    }
+
+    if (i2c_fd != -1)
+    {
+        close(i2c_fd);
+    }
+
+    return b_is_all_ok;
+}
+
+static bool
+record_wait_irq(apds9960_irq_t *p_irq, const struct timespec *p_now,
+    const struct timespec *p_deadline, const struct timespec *p_end)
+{
+    struct pollfd pfd = { apds9960_irq_get_fd(p_irq), POLLIN, 0 };
+    const struct timespec *p_wake = p_end;
+    bool b_is_asserted = false;
+    int64_t timeout_ms;
+
+    // INT still low means data arrived while servicing, no edge will follow
+    if (!apds9960_irq_is_asserted(p_irq, &b_is_asserted))
+    {
+        return false;
+    }
+
+    if (b_is_asserted)
+    {
+        return true;
+    }
+
+    if ((p_deadline->tv_sec != 0) || (p_deadline->tv_nsec != 0))
+    {
+        p_wake = p_deadline;
+    }
+
+    timeout_ms = (p_wake->tv_sec - p_now->tv_sec) * 1000 +
+        (p_wake->tv_nsec - p_now->tv_nsec) / 1000000;
+    if (timeout_ms < 0)
+    {
+        timeout_ms = 0;
+    }
+
+    // Sleeps without wakeups until INT edge, gesture deadline or end
+    if ((poll(&pfd, 1, (int)timeout_ms) > 0) &&
+        (apds9960_irq_handle(p_irq) == -1))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+record_sim(uint32_t swipes, unsigned int seed, apds9960_capture_t *p_cap)
+{
+    static const int DIRECTIONS[] = {
+        GESTURE_DIR_LEFT, GESTURE_DIR_RIGHT, GESTURE_DIR_UP, GESTURE_DIR_DOWN
+    };
+    const uint32_t direction_count = sizeof(DIRECTIONS) / sizeof(DIRECTIONS[0]);
+
+    apds9960_sim_frame_t frames[RECORD_SWIPE_FRAMES];
+    struct timespec now = { 0, 0 };
+    struct timespec deadline;
+    bool b_is_all_ok = false;
+
+    apds9960_sim_t *p_sim = apds9960_sim_open(true);
+    apds9960_t *p_apds = NULL;
+
+    if (p_sim)
+    {
+        p_apds = apds9960_open_transport(&apds9960_transport_sim, p_sim, -1,
+            APDS9960_I2C_ADDRESS);
+    }
+
+    if (p_apds && apds9960_gesture_enable(p_apds, false))
+    {
+        b_is_all_ok = apds9960_capture_config(p_cap, p_apds);
+        apds9960_gesture_set_hook(p_apds, apds9960_capture_hook, p_cap);
+        srand(seed);
+
+        for (uint32_t idx = 0; b_is_all_ok && (idx < swipes * direction_count);
+            idx++)
+        {
+            int direction = DIRECTIONS[idx % direction_count];
+            uint32_t duration_ms = 150 + (uint32_t)(rand() % 450);
+            uint8_t peak = (uint8_t)(60 + rand() % 190);
+            size_t count = apds9960_sim_script_swipe(frames,
+                RECORD_SWIPE_FRAMES, 100, duration_ms, direction, peak);
+
+            b_is_all_ok = apds9960_capture_label(p_cap, direction);
+            apds9960_sim_load_script(p_sim, frames, count, false);
+
+            // Poll like an event loop until the hand is gone for a while
+            for (uint32_t time_ms = 0; b_is_all_ok && (time_ms < duration_ms + 400);
+                time_ms += RECORD_POLL_MS)
+            {
+                apds9960_sim_advance(p_sim, RECORD_POLL_MS * 1000);
+                now.tv_nsec += RECORD_POLL_MS * 1000000L;
+                if (now.tv_nsec >= 1000000000L)
+                {
+                    now.tv_nsec -= 1000000000L;
+                    now.tv_sec++;
+                }
+                b_is_all_ok = (apds9960_gesture_poll(p_apds, &now, &deadline) != -1);
+            }
+        }
+
+        apds9960_gesture_set_hook(p_apds, NULL, NULL);
+    }
+
+    if (p_apds)
+    {
+        apds9960_close(p_apds);
+    }
+    apds9960_sim_close(p_sim);
+
+    return b_is_all_ok;
+}
+
+static int
+parse_direction(const char *p_name)
+{
+    static const char *NAMES[GESTURE_DIR_ALL] = {
+        "none", "left", "right", "up", "down", "near", "far"
+    };
+
+    for (int idx = 0; idx < GESTURE_DIR_ALL; idx++)
+    {
+        if (strcmp(p_name, NAMES[idx]) == 0)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,185 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_capture.h"
+
+// Replay statistics over all captures
+typedef struct
+{
+    bool b_is_verbose;
+    const char *p_file_name;
+    uint64_t gestures;
+    uint64_t labeled;           // Gestures decoded under a label
+    uint64_t matched;           // Labeled gestures equal to label
+} replay_stats_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Replay a single capture file through the gesture decoder.
+ *
+ * File is mapped to memory, decoding runs without any I/O.
+ *
+ * @param p_path Capture file path.
+ * @param p_stats Statistics to update.
+ * @param p_bytes Incremented by capture size.
+ *
+ * @return true on success.
+ */
+static bool
+replay_file(const char *p_path, replay_stats_t *p_stats, uint64_t *p_bytes);
+
+static void
+replay_gesture(void *p_ctx, const apds9960_replay_gesture_t *p_gesture);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const char *GESTURE_NAMES[GESTURE_DIR_ALL] = {
+    "none", "left", "right", "up", "down", "near", "far"
+};
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    replay_stats_t stats;
+    struct timespec start;
+    struct timespec end;
+    uint64_t bytes = 0;
+    double elapsed_s;
+    bool b_is_all_ok = true;
+    int opt;
+
+    memset(&stats, 0, sizeof(stats));
+
+    while ((opt = getopt(argc, argv, "vh")) != -1)
+    {
+        if (opt == 'v')
+        {
+            stats.b_is_verbose = true;
+        }
+        else
+        {
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-v] capture.agc...\n"
+            "Replays gesture captures through the decoder, -v lists every "
+            "decoded gesture.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int idx = optind; idx < argc; idx++)
+    {
+        b_is_all_ok = replay_file(argv[idx], &stats, &bytes) && b_is_all_ok;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_s = (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("files %d, bytes %llu, gestures %llu, labeled %llu, "
+        "matched %llu (%.1f %%), %.3f s, %.0f gestures/s\n",
+        argc - optind, (unsigned long long)bytes,
+        (unsigned long long)stats.gestures,
+        (unsigned long long)stats.labeled, (unsigned long long)stats.matched,
+        stats.labeled ? (100.0 * stats.matched) / stats.labeled : 0.0,
+        elapsed_s, (elapsed_s > 0) ? stats.gestures / elapsed_s : 0.0);
+
+    return b_is_all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+replay_file(const char *p_path, replay_stats_t *p_stats, uint64_t *p_bytes)
+{
+    apds9960_gesture_decoder_t decoder;
+    struct stat file_stat;
+    void *p_data = MAP_FAILED;
+    bool b_is_all_ok = false;
+
+    int fd = open(p_path, O_RDONLY | O_CLOEXEC);
+
+    if ((fd != -1) && (fstat(fd, &file_stat) == 0) && (file_stat.st_size > 0))
+    {
+        p_data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+    }
+
+    if (p_data != MAP_FAILED)
+    {
+        p_stats->p_file_name = p_path;
+        apds9960_gesture_decoder_init(&decoder, NULL);
+        b_is_all_ok = (apds9960_capture_replay(p_data,
+            (size_t)file_stat.st_size, &decoder, replay_gesture, p_stats,
+            NULL) != -1);
+
+        *p_bytes += (uint64_t)file_stat.st_size;
+        munmap(p_data, (size_t)file_stat.st_size);
+    }
+    else
+    {
+        fprintf(stderr, "Cannot read %s: %s\n", p_path, strerror(errno));
+    }
+
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    return b_is_all_ok;
+}
+
+static void
+replay_gesture(void *p_ctx, const apds9960_replay_gesture_t *p_gesture)
+{
+    replay_stats_t *p_stats = (replay_stats_t *)p_ctx;
+
+    p_stats->gestures++;
+
+    if (p_gesture->label != GESTURE_DIR_NONE)
+    {
+        p_stats->labeled++;
+        if (p_gesture->gesture == p_gesture->label)
+        {
+            p_stats->matched++;
+        }
+    }
+
+    if (p_stats->b_is_verbose)
+    {
+        printf("%s %10.3f s %-5s label %-5s datasets %u\n",
+            p_stats->p_file_name, p_gesture->time_us / 1e6,
+            GESTURE_NAMES[p_gesture->gesture % GESTURE_DIR_ALL],
+            GESTURE_NAMES[p_gesture->label % GESTURE_DIR_ALL],
+            p_gesture->dset_count);
+    }
+}
+
+/* [] END OF FILE */
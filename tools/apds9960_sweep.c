@@ -0,0 +1,450 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib_apds9960.h"
+#include "apds9960_capture.h"
+
+#define SWEEP_THREADS_MAX   256
+
+// Parameter range start:end:step
+typedef struct
+{
+    int start;
+    int end;
+    int step;
+} sweep_range_t;
+
+// Capture file mapped to memory
+typedef struct
+{
+    const uint8_t *p_data;
+    size_t data_len;
+} sweep_capture_t;
+
+// Decoding results of one parameter set
+typedef struct
+{
+    apds9960_gesture_params_t params;
+    uint32_t confusion[GESTURE_DIR_ALL][GESTURE_DIR_ALL];  // [label][decoded]
+    uint32_t correct;
+    uint32_t total;
+} sweep_result_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Worker thread, takes parameter sets from the shared job counter.
+ *
+ * @param p_arg Unused.
+ *
+ * @return NULL.
+ */
+static void
+*sweep_worker(void *p_arg);
+
+static void
+sweep_gesture(void *p_ctx, const apds9960_replay_gesture_t *p_gesture);
+
+static void
+sweep_finish(sweep_result_t *p_result);
+
+static bool
+sweep_load(const char *p_path);
+
+static void
+sweep_count_labels(const uint8_t *p_data, size_t data_len);
+
+static bool
+parse_range(const char *p_text, sweep_range_t *p_range);
+
+static void
+print_result(const sweep_result_t *p_result, uint32_t set, bool b_is_matrix);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const char *GESTURE_NAMES[GESTURE_DIR_ALL] = {
+    "none", "left", "right", "up", "down", "near", "far"
+};
+
+static sweep_capture_t *p_captures = NULL;
+static uint32_t capture_count = 0;
+
+// Labeled segments per gesture over the whole corpus
+static uint32_t label_segments[GESTURE_DIR_ALL];
+
+static sweep_result_t *p_results = NULL;
+static uint32_t result_count = 0;
+static uint32_t next_job = 0;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    apds9960_gesture_params_t defaults;
+    sweep_range_t ranges[5];
+    pthread_t threads[SWEEP_THREADS_MAX];
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    bool b_is_matrix = true;
+    bool b_is_all_ok = true;
+    uint32_t best = 0;
+    int opt;
+
+    apds9960_gesture_params_default(&defaults);
+
+    // thold_out, sens_1, sens_2, near_count, far_count
+    ranges[0] = (sweep_range_t){ defaults.thold_out, defaults.thold_out, 1 };
+    ranges[1] = (sweep_range_t){ defaults.sens_1, defaults.sens_1, 1 };
+    ranges[2] = (sweep_range_t){ defaults.sens_2, defaults.sens_2, 1 };
+    ranges[3] = (sweep_range_t){ defaults.near_count, defaults.near_count, 1 };
+    ranges[4] = (sweep_range_t){ defaults.far_count, defaults.far_count, 1 };
+
+    while ((opt = getopt(argc, argv, "t:1:2:n:f:j:qh")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                b_is_all_ok = parse_range(optarg, &ranges[0]) && b_is_all_ok;
+                break;
+
+            case '1':
+                b_is_all_ok = parse_range(optarg, &ranges[1]) && b_is_all_ok;
+                break;
+
+            case '2':
+                b_is_all_ok = parse_range(optarg, &ranges[2]) && b_is_all_ok;
+                break;
+
+            case 'n':
+                b_is_all_ok = parse_range(optarg, &ranges[3]) && b_is_all_ok;
+                break;
+
+            case 'f':
+                b_is_all_ok = parse_range(optarg, &ranges[4]) && b_is_all_ok;
+                break;
+
+            case 'j':
+                thread_count = atol(optarg);
+                break;
+
+            case 'q':
+                b_is_matrix = false;
+                break;
+
+            default:
+                b_is_all_ok = false;
+                break;
+        }
+    }
+
+    if (!b_is_all_ok || (optind >= argc))
+    {
+        fprintf(stderr,
+            "Usage: %s [-t thold_out] [-1 sens_1] [-2 sens_2] [-n near_count]\n"
+            "       [-f far_count] [-j threads] [-q] capture.agc...\n"
+            "Parameters take a value or start:end[:step] range. Decodes the\n"
+            "labeled corpus with every parameter combination and reports\n"
+            "accuracy and confusion matrix, -q prints accuracy only.\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int idx = optind; b_is_all_ok && (idx < argc); idx++)
+    {
+        b_is_all_ok = sweep_load(argv[idx]);
+    }
+
+    // Parameter grid
+    result_count = 1;
+    for (int idx = 0; idx < 5; idx++)
+    {
+        result_count *= (uint32_t)((ranges[idx].end - ranges[idx].start) /
+            ranges[idx].step + 1);
+    }
+
+    p_results = calloc(result_count, sizeof(sweep_result_t));
+    if (!b_is_all_ok || (p_results == NULL))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t set = 0; set < result_count; set++)
+    {
+        int values[5];
+        uint32_t rest = set;
+
+        for (int idx = 4; idx >= 0; idx--)
+        {
+            uint32_t steps = (uint32_t)((ranges[idx].end - ranges[idx].start) /
+                ranges[idx].step + 1);
+
+            values[idx] = ranges[idx].start + (int)(rest % steps) *
+                ranges[idx].step;
+            rest /= steps;
+        }
+
+        p_results[set].params.thold_out = (uint8_t)values[0];
+        p_results[set].params.sens_1 = values[1];
+        p_results[set].params.sens_2 = values[2];
+        p_results[set].params.near_count = values[3];
+        p_results[set].params.far_count = values[4];
+    }
+
+    if (thread_count < 1)
+    {
+        thread_count = 1;
+    }
+    else if (thread_count > SWEEP_THREADS_MAX)
+    {
+        thread_count = SWEEP_THREADS_MAX;
+    }
+
+    long started = 0;
+
+    while (started < thread_count)
+    {
+        int err = pthread_create(&threads[started], NULL, sweep_worker, NULL);
+
+        if (err != 0)
+        {
+            fprintf(stderr, "Cannot start thread: %s\n", strerror(err));
+            b_is_all_ok = false;
+            break;
+        }
+
+        started++;
+    }
+
+    // Workers share the set counter, running ones finish all sets anyway
+    for (long idx = 0; idx < started; idx++)
+    {
+        pthread_join(threads[idx], NULL);
+    }
+
+    if (!b_is_all_ok)
+    {
+        free(p_results);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t set = 0; set < result_count; set++)
+    {
+        print_result(&p_results[set], set, b_is_matrix);
+
+        if (p_results[set].correct > p_results[best].correct)
+        {
+            best = set;
+        }
+    }
+
+    printf("Best of %u sets (%u captures, %ld threads):\n", result_count,
+        capture_count, thread_count);
+    print_result(&p_results[best], best, false);
+
+    free(p_results);
+
+    return EXIT_SUCCESS;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+*sweep_worker(void *p_arg)
+{
+    apds9960_gesture_decoder_t decoder;
+    uint32_t set;
+
+    // Every job is one parameter set over the whole corpus
+    while ((set = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) <
+        result_count)
+    {
+        sweep_result_t *p_result = &p_results[set];
+
+        apds9960_gesture_decoder_init(&decoder, &p_result->params);
+
+        for (uint32_t idx = 0; idx < capture_count; idx++)
+        {
+            apds9960_capture_replay(p_captures[idx].p_data,
+                p_captures[idx].data_len, &decoder, sweep_gesture, p_result,
+                NULL);
+        }
+
+        sweep_finish(p_result);
+    }
+
+    return NULL;
+}
+
+static void
+sweep_gesture(void *p_ctx, const apds9960_replay_gesture_t *p_gesture)
+{
+    sweep_result_t *p_result = (sweep_result_t *)p_ctx;
+
+    if ((p_gesture->label > GESTURE_DIR_NONE) &&
+        (p_gesture->label < GESTURE_DIR_ALL) &&
+        (p_gesture->gesture < GESTURE_DIR_ALL))
+    {
+        p_result->confusion[p_gesture->label][p_gesture->gesture]++;
+    }
+}
+
+static void
+sweep_finish(sweep_result_t *p_result)
+{
+    // Labeled segments without any decoded gesture are missed gestures
+    for (int label = GESTURE_DIR_NONE + 1; label < GESTURE_DIR_ALL; label++)
+    {
+        uint32_t decoded = 0;
+
+        for (int gesture = 0; gesture < GESTURE_DIR_ALL; gesture++)
+        {
+            decoded += p_result->confusion[label][gesture];
+        }
+
+        if (decoded < label_segments[label])
+        {
+            p_result->confusion[label][GESTURE_DIR_NONE] +=
+                label_segments[label] - decoded;
+        }
+
+        p_result->correct += p_result->confusion[label][label];
+        p_result->total += (decoded > label_segments[label]) ?
+            decoded : label_segments[label];
+    }
+}
+
+static bool
+sweep_load(const char *p_path)
+{
+    struct stat file_stat;
+    void *p_data = MAP_FAILED;
+    sweep_capture_t *p_grown;
+
+    int fd = open(p_path, O_RDONLY | O_CLOEXEC);
+
+    if ((fd != -1) && (fstat(fd, &file_stat) == 0) && (file_stat.st_size > 0))
+    {
+        p_data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+    }
+
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    if (p_data == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot read %s: %s\n", p_path, strerror(errno));
+        return false;
+    }
+
+    p_grown = realloc(p_captures, (capture_count + 1) * sizeof(sweep_capture_t));
+    if (p_grown == NULL)
+    {
+        return false;
+    }
+
+    p_captures = p_grown;
+    p_captures[capture_count].p_data = p_data;
+    p_captures[capture_count].data_len = (size_t)file_stat.st_size;
+    capture_count++;
+
+    sweep_count_labels(p_data, (size_t)file_stat.st_size);
+
+    return true;
+}
+
+static void
+sweep_count_labels(const uint8_t *p_data, size_t data_len)
+{
+    size_t pos = APDS9960_CAPTURE_HEADER_SIZE;
+
+    // Walk records as described in apds9960_capture.h
+    while (pos + APDS9960_CAPTURE_RECORD_SIZE <= data_len)
+    {
+        if ((p_data[pos] == CAPTURE_REC_LABEL) &&
+            (p_data[pos + 2] > GESTURE_DIR_NONE) &&
+            (p_data[pos + 2] < GESTURE_DIR_ALL))
+        {
+            label_segments[p_data[pos + 2]]++;
+        }
+
+        pos += APDS9960_CAPTURE_RECORD_SIZE + p_data[pos + 1];
+    }
+}
+
+static bool
+parse_range(const char *p_text, sweep_range_t *p_range)
+{
+    int count = sscanf(p_text, "%d:%d:%d", &p_range->start, &p_range->end,
+        &p_range->step);
+
+    if (count == 1)
+    {
+        p_range->end = p_range->start;
+    }
+
+    if (count < 3)
+    {
+        p_range->step = 1;
+    }
+
+    return (count >= 1) && (p_range->step > 0) &&
+        (p_range->end >= p_range->start);
+}
+
+static void
+print_result(const sweep_result_t *p_result, uint32_t set, bool b_is_matrix)
+{
+    printf("set %u thold_out %u sens_1 %d sens_2 %d near %d far %d: "
+        "accuracy %.2f %% (%u/%u)\n", set, p_result->params.thold_out,
+        p_result->params.sens_1, p_result->params.sens_2,
+        p_result->params.near_count, p_result->params.far_count,
+        p_result->total ? (100.0 * p_result->correct) / p_result->total : 0.0,
+        p_result->correct, p_result->total);
+
+    if (b_is_matrix)
+    {
+        printf("  label\\decoded");
+        for (int gesture = 0; gesture < GESTURE_DIR_ALL; gesture++)
+        {
+            printf(" %6s", GESTURE_NAMES[gesture]);
+        }
+        printf("\n");
+
+        for (int label = GESTURE_DIR_NONE + 1; label < GESTURE_DIR_ALL; label++)
+        {
+            if (label_segments[label] == 0)
+            {
+                continue;
+            }
+
+            printf("  %-13s", GESTURE_NAMES[label]);
+            for (int gesture = 0; gesture < GESTURE_DIR_ALL; gesture++)
+            {
+                printf(" %6u", p_result->confusion[label][gesture]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+/* [] END OF FILE */